@@ -0,0 +1,147 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_BENCH_SCENE_H
+#define ITU_GRAPHICS_PROGRAMMING_BENCH_SCENE_H
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cmath>
+#include <cfloat>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/transform.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include "rt_types.h"
+#include "rt_texture.h"
+#include "primitives.h"
+
+namespace bench{
+
+    // the grey room around the scene, the same cube used in exercise_10_sol scaled by -2 so that it is seen from inside
+    inline void addRoom(std::vector<rt::vertex> &vts){
+        std::vector<glm::vec3> points;
+        std::vector<glm::vec4> colors;
+        std::vector<glm::vec3> normals;
+        std::vector<glm::vec2> uvs;
+        Primitives::makeCube(2.f, points, normals, uvs, colors);
+
+        glm::mat4 outsideout = glm::scale(glm::vec3(-2.f,-2.f,-2.f));
+        for (unsigned int i = 0; i < points.size(); i++){
+            rt::vertex v{outsideout * glm::vec4(points[i], 1.0f),
+                         glm::vec4(normals[i], 0),
+                         rt::grey,
+                         uvs[i]
+            };
+            vts.push_back(v);
+        }
+    }
+
+    // the small colored cube of exercise_10_sol (without the room)
+    inline void makeCubeScene(std::vector<rt::vertex> &vts){
+        std::vector<glm::vec3> points;
+        std::vector<glm::vec4> colors;
+        std::vector<glm::vec3> normals;
+        std::vector<glm::vec2> uvs;
+        Primitives::makeCube(2.f, points, normals, uvs, colors);
+
+        glm::mat4 scale = glm::scale(glm::vec3(.25f,.25f,.25f));
+        for (unsigned int i = 0; i < points.size(); i++){
+            rt::vertex v{scale * glm::vec4(points[i], 1.0f),
+                         glm::vec4(normals[i], 0),
+                         colors[i],
+                         uvs[i]
+            };
+            vts.push_back(v);
+        }
+    }
+
+    // loads all the meshes in a model file (any format assimp supports) as a triangle list (without the room), the model is scaled and
+    // centered to fit in the [-.5, .5] cube, so that any model can be used with the same camera paths.
+    // returns false if the file could not be loaded
+    inline bool loadModelScene(const std::string &path, std::vector<rt::vertex> &vts){
+        Assimp::Importer importer;
+        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals |
+                                                       aiProcess_PreTransformVertices);
+        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+        {
+            std::cerr << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+            return false;
+        }
+
+        std::vector<rt::vertex> model;
+        glm::vec3 bbMin(FLT_MAX), bbMax(-FLT_MAX);
+        // aiProcess_PreTransformVertices already applied the node transforms, so the meshes can be read directly
+        for (unsigned int m = 0; m < scene->mNumMeshes; m++){
+            const aiMesh *mesh = scene->mMeshes[m];
+            for (unsigned int f = 0; f < mesh->mNumFaces; f++){
+                const aiFace &face = mesh->mFaces[f];
+                if (face.mNumIndices != 3) continue; // points and lines
+                for (unsigned int k = 0; k < 3; k++){
+                    unsigned int i = face.mIndices[k];
+                    glm::vec3 p(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+                    glm::vec3 n = mesh->HasNormals() ?
+                            glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z) : glm::vec3(0,1,0);
+                    glm::vec2 uv = mesh->HasTextureCoords(0) ?
+                            glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y) : glm::vec2(0);
+                    rt::Colors::color col = mesh->HasVertexColors(0) ?
+                            rt::Colors::color(mesh->mColors[0][i].r, mesh->mColors[0][i].g,
+                                              mesh->mColors[0][i].b, mesh->mColors[0][i].a) : rt::Colors::white;
+                    model.push_back(rt::vertex{glm::vec4(p, 1), glm::vec4(n, 0), col, uv});
+                    bbMin = glm::min(bbMin, p);
+                    bbMax = glm::max(bbMax, p);
+                }
+            }
+        }
+        if (model.empty()){
+            std::cerr << "ERROR: " << path << " has no triangles" << std::endl;
+            return false;
+        }
+
+        glm::vec3 extent = bbMax - bbMin;
+        float size = glm::max(glm::max(extent.x, extent.y), extent.z);
+        glm::mat4 normalize = glm::scale(glm::vec3(size > 0 ? 1.0f / size : 1.0f)) *
+                              glm::translate(-(bbMin + bbMax) * .5f);
+        for (auto &v : model)
+            v.pos = normalize * v.pos;
+
+        vts = model;
+        return true;
+    }
+
+    // deforms the model with a wave along the x axis that moves with time, rest holds the original positions
+    inline void animate(std::vector<rt::vertex> &vts, const std::vector<rt::vertex> &rest, size_t count, float time){
+        for (size_t i = 0; i < count; i++){
+            glm::vec4 p = rest[i].pos;
+            vts[i].pos = p + glm::vec4(.1f * sin(8.0f * p.y + time), 0, 0, 0);
+        }
+    }
+
+    // checkerboard of size x size texels in squares of 8x8 texels, to benchmark texture sampling
+    inline void makeCheckerTexture(unsigned int size, rt::Texture &texture){
+        std::vector<std::uint32_t> texels(size * size);
+        for (unsigned int y = 0; y < size; y++)
+            for (unsigned int x = 0; x < size; x++)
+                texels[y * size + x] = rt::Colors::toRGBA32((x / 8 + y / 8) % 2 ? rt::Colors::white : rt::Colors::grey);
+        texture.load(size, size, texels.data());
+    }
+
+    // fixed camera paths, so that the same frames are rendered in every run
+    enum CameraPath{
+        STATIC, // the initial view of exercise_10_sol in every frame
+        ORBIT   // one full turn around the center of the scene over all frames
+    };
+
+    inline glm::mat4 viewMatrix(CameraPath path, unsigned int frame, unsigned int numFrames){
+        if (path == ORBIT){
+            float angle = glm::two_pi<float>() * frame / numFrames;
+            glm::vec3 eye(sin(angle) * 1.6f, .3f, cos(angle) * 1.6f);
+            return glm::lookAt(eye, glm::vec3(0), glm::vec3(0, 1, 0));
+        }
+        glm::vec3 eye(0.9f, 0.0f, 1.5f);
+        return glm::lookAt(eye, eye + glm::vec3(0, 0, -1), glm::vec3(0, 1, 0));
+    }
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_BENCH_SCENE_H
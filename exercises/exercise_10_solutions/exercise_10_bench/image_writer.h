@@ -0,0 +1,127 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_IMAGE_WRITER_H
+#define ITU_GRAPHICS_PROGRAMMING_IMAGE_WRITER_H
+
+#include <cstdint>
+#include <cassert>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <fstream>
+#include "frame_buffer.h"
+
+namespace bench{
+
+    // RGB bytes of the frame buffer from the top row to the bottom one (row 0 of the frame buffer is the bottom of
+    // the image, as in OpenGL textures), the alpha channel is dropped
+    inline std::vector<uint8_t> topDownRGB(FrameBuffer<uint32_t> &fb){
+        fb.resolveClears();
+        std::vector<uint8_t> rgb(fb.W * fb.H * 3);
+        for (unsigned int r = 0; r < fb.H; r++){
+            const uint32_t *row = &fb.buffer[(fb.H - 1 - r) * fb.W];
+            for (unsigned int c = 0; c < fb.W; c++){
+                uint8_t *px = &rgb[(r * fb.W + c) * 3];
+                px[0] = row[c] & 0xff;
+                px[1] = (row[c] >> 8) & 0xff;
+                px[2] = (row[c] >> 16) & 0xff;
+            }
+        }
+        return rgb;
+    }
+
+    // binary PPM (P6)
+    inline bool writePPM(const std::string &path, FrameBuffer<uint32_t> &fb){
+        std::ofstream file(path, std::ios::binary);
+        if (!file) return false;
+        std::vector<uint8_t> rgb = topDownRGB(fb);
+        file << "P6\n" << fb.W << " " << fb.H << "\n255\n";
+        file.write((const char *) rgb.data(), rgb.size());
+        return (bool) file;
+    }
+
+    namespace png{
+        inline uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0){
+            static uint32_t table[256] = {0};
+            if (table[1] == 0){
+                for (uint32_t n = 0; n < 256; n++){
+                    uint32_t c = n;
+                    for (int k = 0; k < 8; k++)
+                        c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                    table[n] = c;
+                }
+            }
+            crc = ~crc;
+            for (size_t i = 0; i < size; i++)
+                crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+            return ~crc;
+        }
+
+        inline void put32(std::vector<uint8_t> &out, uint32_t v){
+            out.push_back(v >> 24); out.push_back(v >> 16); out.push_back(v >> 8); out.push_back(v);
+        }
+
+        inline void writeChunk(std::ofstream &file, const char *type, const std::vector<uint8_t> &data){
+            std::vector<uint8_t> chunk;
+            put32(chunk, (uint32_t) data.size());
+            chunk.insert(chunk.end(), type, type + 4);
+            chunk.insert(chunk.end(), data.begin(), data.end());
+            put32(chunk, crc32(&chunk[4], chunk.size() - 4));
+            file.write((const char *) chunk.data(), chunk.size());
+        }
+    }
+
+    // PNG without compression (the zlib stream uses stored blocks), so that no extra library is needed
+    inline bool writePNG(const std::string &path, FrameBuffer<uint32_t> &fb){
+        std::ofstream file(path, std::ios::binary);
+        if (!file) return false;
+
+        // each row starts with the filter type, 0 (none)
+        std::vector<uint8_t> rgb = topDownRGB(fb);
+        std::vector<uint8_t> raw;
+        raw.reserve(rgb.size() + fb.H);
+        for (unsigned int r = 0; r < fb.H; r++){
+            raw.push_back(0);
+            raw.insert(raw.end(), rgb.begin() + r * fb.W * 3, rgb.begin() + (r + 1) * fb.W * 3);
+        }
+
+        // zlib header, stored deflate blocks of up to 65535 bytes and the adler32 checksum
+        std::vector<uint8_t> zlib = {0x78, 0x01};
+        size_t pos = 0;
+        do {
+            size_t len = std::min<size_t>(65535, raw.size() - pos);
+            zlib.push_back(pos + len == raw.size() ? 1 : 0); // last block flag
+            zlib.push_back(len & 0xff); zlib.push_back(len >> 8);
+            zlib.push_back(~len & 0xff); zlib.push_back((~len >> 8) & 0xff);
+            zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + len);
+            pos += len;
+        } while (pos < raw.size());
+        uint32_t a = 1, b = 0;
+        for (uint8_t byte : raw){
+            a = (a + byte) % 65521;
+            b = (b + a) % 65521;
+        }
+        png::put32(zlib, (b << 16) | a);
+
+        std::vector<uint8_t> header;
+        png::put32(header, fb.W);
+        png::put32(header, fb.H);
+        header.push_back(8); // bits per channel
+        header.push_back(2); // RGB
+        header.push_back(0); header.push_back(0); header.push_back(0); // compression, filter and no interlace
+
+        const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        file.write((const char *) signature, 8);
+        png::writeChunk(file, "IHDR", header);
+        png::writeChunk(file, "IDAT", zlib);
+        png::writeChunk(file, "IEND", std::vector<uint8_t>());
+        return (bool) file;
+    }
+
+    // picks the format from the extension of the file, .png or anything else for .ppm
+    inline bool writeImage(const std::string &path, FrameBuffer<uint32_t> &fb){
+        if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0)
+            return writePNG(path, fb);
+        return writePPM(path, fb);
+    }
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_IMAGE_WRITER_H
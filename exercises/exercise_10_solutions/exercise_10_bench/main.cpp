@@ -0,0 +1,280 @@
+// headless benchmark of the ray tracer of exercise 10.
+// renders a scene with a fixed camera path and reports the timings as JSON, without creating a window, e.g.
+//   exercise_10_bench --scene cube --width 512 --height 512 --depth 3 --frames 16 --path orbit --output last.png
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include "rt_renderer.h"
+#include "bench_scene.h"
+#include "image_writer.h"
+
+struct Options{
+    std::string scene = "cube";  // "cube" or the path to a model file
+    unsigned int width = 256, height = 256;
+    unsigned int depth = 2;      // 1 == no reflections
+    unsigned int frames = 8;
+    bench::CameraPath path = bench::STATIC;
+    float fov = 70.0f;
+    unsigned int threads = 0;    // 0 == one per core
+    unsigned int tile_size = 16;
+    bool bvh = true;
+    bool packets = RT_PACKET_SIMD;
+    bool wavefront = false;
+    bool stats = false;
+    std::string animate;         // "refit" or "rebuild" to deform the model every frame, static if empty
+    unsigned int texture = 0;    // size of the checkerboard texture on all surfaces, no texture if 0
+    rt::Texture::Filter filter = rt::Texture::trilinear;
+    std::string layout = "linear"; // memory layout of the frame buffer: linear, tiled or morton
+    bool srgb = false;           // sRGB encoding of the colors
+    bool dither = false;         // ordered dithering of the colors
+    std::string output;          // image of the last frame (.ppm or .png), none if empty
+    std::string json;            // report file, stdout if empty
+};
+
+void printUsage(){
+    std::cerr << "usage: exercise_10_bench [options]\n"
+                 "  --scene cube|<model file>  scene to render (default cube)\n"
+                 "  --width <n> --height <n>   resolution (default 256x256)\n"
+                 "  --depth <n>                ray depth, 1 == no reflections (default 2)\n"
+                 "  --frames <n>               number of frames rendered (default 8)\n"
+                 "  --path static|orbit        camera path (default static)\n"
+                 "  --fov <degrees>            vertical field of view (default 70)\n"
+                 "  --threads <n>              0 == one per core (default 0)\n"
+                 "  --tile <n>                 tile size in pixels (default 16)\n"
+                 "  --no-bvh                   test every triangle (slow!)\n"
+                 "  --no-packets               trace primary rays one by one\n"
+                 "  --wavefront                trace the tiles bounce by bounce\n"
+                 "  --animate refit|rebuild    deform the model every frame, refitting or rebuilding the BVH\n"
+                 "  --texture <n>              checkerboard texture of n x n texels on all surfaces (default none)\n"
+                 "  --filter nearest|bilinear|trilinear  texture filtering (default trilinear)\n"
+                 "  --layout linear|tiled|morton  frame buffer memory layout, linearized after each frame (default linear)\n"
+                 "  --srgb                     encode the colors with the sRGB transfer function\n"
+                 "  --dither                   ordered dithering of the colors\n"
+                 "  --stats                    count the ray-triangle tests of the shadow rays (slower)\n"
+                 "  --output <file.ppm|png>    write the last frame\n"
+                 "  --json <file>              write the report to a file instead of stdout\n";
+}
+
+bool parseArguments(int argc, char **argv, Options &opt){
+    for (int i = 1; i < argc; i++){
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--no-bvh") opt.bvh = false;
+        else if (arg == "--no-packets") opt.packets = false;
+        else if (arg == "--wavefront") opt.wavefront = true;
+        else if (arg == "--stats") opt.stats = true;
+        else if (arg == "--srgb") opt.srgb = true;
+        else if (arg == "--dither") opt.dither = true;
+        else if (arg == "--help" || arg == "-h") return false;
+        else if (!hasValue) {
+            std::cerr << "unknown option or missing value: " << arg << std::endl;
+            return false;
+        }
+        else {
+            std::string value = argv[++i];
+            if (arg == "--scene") opt.scene = value;
+            else if (arg == "--width") opt.width = std::max(1, std::atoi(value.c_str()));
+            else if (arg == "--height") opt.height = std::max(1, std::atoi(value.c_str()));
+            else if (arg == "--depth") opt.depth = std::max(1, std::atoi(value.c_str()));
+            else if (arg == "--frames") opt.frames = std::max(1, std::atoi(value.c_str()));
+            else if (arg == "--fov") opt.fov = (float) std::atof(value.c_str());
+            else if (arg == "--threads") opt.threads = std::max(0, std::atoi(value.c_str()));
+            else if (arg == "--tile") opt.tile_size = std::max(1, std::atoi(value.c_str()));
+            else if (arg == "--output") opt.output = value;
+            else if (arg == "--json") opt.json = value;
+            else if (arg == "--texture") opt.texture = std::max(0, std::atoi(value.c_str()));
+            else if (arg == "--filter" && (value == "nearest" || value == "bilinear" || value == "trilinear"))
+                opt.filter = value == "nearest" ? rt::Texture::nearest :
+                             value == "bilinear" ? rt::Texture::bilinear : rt::Texture::trilinear;
+            else if (arg == "--animate" && (value == "refit" || value == "rebuild")) opt.animate = value;
+            else if (arg == "--layout" && (value == "linear" || value == "tiled" || value == "morton")) opt.layout = value;
+            else if (arg == "--path" && (value == "static" || value == "orbit"))
+                opt.path = value == "orbit" ? bench::ORBIT : bench::STATIC;
+            else {
+                std::cerr << "unknown option or invalid value: " << arg << " " << value << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// JSON strings can't have unescaped quotes and backslashes (e.g. windows paths)
+std::string jsonString(const std::string &s){
+    std::string out = "\"";
+    for (char c : s){
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+double millisecondsSince(std::chrono::high_resolution_clock::time_point start){
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    using namespace std;
+    typedef chrono::high_resolution_clock clock;
+
+    Options opt;
+    if (!parseArguments(argc, argv, opt)){
+        printUsage();
+        return 1;
+    }
+
+    // load the scene
+    // --------------
+    auto loadStart = clock::now();
+    vector<rt::vertex> vts;
+    if (opt.scene == "cube")
+        bench::makeCubeScene(vts);
+    else if (!bench::loadModelScene(opt.scene, vts))
+        return 1;
+    // only the model is animated, the room is added after it
+    size_t modelVertices = vts.size();
+    bench::addRoom(vts);
+    vector<rt::vertex> rest = vts;
+    double loadMs = millisecondsSince(loadStart);
+
+    rt::Renderer renderer;
+    renderer.use_bvh = opt.bvh;
+    renderer.use_packets = opt.packets;
+    renderer.num_threads = opt.threads;
+    renderer.tile_size = opt.tile_size;
+    renderer.wavefront = opt.wavefront;
+    renderer.collect_stats = opt.stats;
+    renderer.color_encoding.srgb = opt.srgb;
+    renderer.color_encoding.dither = opt.dither;
+    rt::Texture texture;
+    if (opt.texture > 0){
+        bench::makeCheckerTexture(opt.texture, texture);
+        renderer.texture = &texture;
+        renderer.texture_filter = opt.filter;
+    }
+    unsigned int threads = opt.threads > 0 ? opt.threads : std::max(1u, std::thread::hardware_concurrency());
+
+    FrameBuffer<uint32_t> frameBuffer(opt.width, opt.height);
+    // with the other layouts the frames are rendered to their own buffer, and then linearized to frameBuffer as they
+    // would be to present them. that copy is part of the frame time
+    FrameBuffer<uint32_t, TiledLayout> tiledBuffer(opt.layout == "tiled" ? opt.width : 0, opt.layout == "tiled" ? opt.height : 0);
+    FrameBuffer<uint32_t, MortonLayout> mortonBuffer(opt.layout == "morton" ? opt.width : 0, opt.layout == "morton" ? opt.height : 0);
+
+    // render the frames
+    // -----------------
+    // the scene is compiled (BVH build) during the first frame (and every frame when animated),
+    // its time is reported apart from the tracing time
+    vector<double> frameMs, traceMs;
+    double sceneBuildMs = 0;
+    rt::RayStats total;
+    for (unsigned int f = 0; f < opt.frames; f++){
+        if (!opt.animate.empty()){
+            bench::animate(vts, rest, modelVertices, .5f * f);
+            if (opt.animate == "refit") renderer.refitScene();
+            else renderer.invalidateScene();
+        }
+        auto frameStart = clock::now();
+        glm::mat4 view = bench::viewMatrix(opt.path, f, opt.frames);
+        if (opt.layout == "tiled"){
+            renderer.render(vts, glm::mat4(1), view, opt.fov, opt.depth, tiledBuffer);
+            frameBuffer.prepareWrite(0, 0, opt.width - 1, opt.height - 1, true);
+            tiledBuffer.linearize(frameBuffer.buffer);
+        }
+        else if (opt.layout == "morton"){
+            renderer.render(vts, glm::mat4(1), view, opt.fov, opt.depth, mortonBuffer);
+            frameBuffer.prepareWrite(0, 0, opt.width - 1, opt.height - 1, true);
+            mortonBuffer.linearize(frameBuffer.buffer);
+        }
+        else
+            renderer.render(vts, glm::mat4(1), view, opt.fov, opt.depth, frameBuffer);
+        frameMs.push_back(millisecondsSince(frameStart));
+        traceMs.push_back(renderer.timings().trace_ms);
+        sceneBuildMs += renderer.timings().scene_build_ms;
+        total += renderer.stats();
+    }
+
+    double writeMs = 0;
+    if (!opt.output.empty()){
+        auto writeStart = clock::now();
+        if (!bench::writeImage(opt.output, frameBuffer)){
+            cerr << "ERROR: could not write " << opt.output << endl;
+            return 1;
+        }
+        writeMs = millisecondsSince(writeStart);
+    }
+
+    // report
+    // ------
+    double traceTotal = 0;
+    for (double ms : traceMs) traceTotal += ms;
+    double frameTotal = 0;
+    for (double ms : frameMs) frameTotal += ms;
+
+    ostringstream json;
+    json << "{\n";
+    json << "  \"scene\": " << jsonString(opt.scene) << ",\n";
+    json << "  \"triangles\": " << vts.size() / 3 << ",\n";
+    json << "  \"width\": " << opt.width << ",\n";
+    json << "  \"height\": " << opt.height << ",\n";
+    json << "  \"depth\": " << opt.depth << ",\n";
+    json << "  \"frames\": " << opt.frames << ",\n";
+    json << "  \"camera_path\": \"" << (opt.path == bench::ORBIT ? "orbit" : "static") << "\",\n";
+    json << "  \"threads\": " << threads << ",\n";
+    json << "  \"tile_size\": " << opt.tile_size << ",\n";
+    json << "  \"bvh\": " << (opt.bvh ? "true" : "false") << ",\n";
+    json << "  \"packets\": " << (opt.packets && opt.bvh ? "true" : "false") << ",\n";
+    json << "  \"animate\": \"" << (opt.animate.empty() ? "none" : opt.animate) << "\",\n";
+    json << "  \"wavefront\": " << (opt.wavefront ? "true" : "false") << ",\n";
+    json << "  \"texture\": " << opt.texture << ",\n";
+    json << "  \"layout\": " << jsonString(opt.layout) << ",\n";
+    json << "  \"srgb\": " << (opt.srgb ? "true" : "false") << ",\n";
+    json << "  \"dither\": " << (opt.dither ? "true" : "false") << ",\n";
+    json << "  \"packet_width\": " << RT_PACKET_WIDTH << ",\n";
+    json << "  \"timings_ms\": {\n";
+    json << "    \"scene_load\": " << loadMs << ",\n";
+    json << "    \"scene_build\": " << sceneBuildMs << ",\n";
+    json << "    \"trace\": " << traceTotal << ",\n";
+    json << "    \"image_write\": " << writeMs << ",\n";
+    json << "    \"frame_mean\": " << frameTotal / opt.frames << ",\n";
+    json << "    \"frame_min\": " << *min_element(frameMs.begin(), frameMs.end()) << ",\n";
+    json << "    \"frame_max\": " << *max_element(frameMs.begin(), frameMs.end()) << ",\n";
+    json << "    \"frames\": [";
+    for (unsigned int f = 0; f < frameMs.size(); f++)
+        json << (f ? ", " : "") << frameMs[f];
+    json << "]\n";
+    json << "  },\n";
+    json << "  \"rays\": {\n";
+    json << "    \"primary\": " << total.primary_rays << ",\n";
+    json << "    \"shadow\": " << total.shadow_rays << ",\n";
+    json << "    \"shadow_occluded\": " << total.shadow_rays_occluded << ",\n";
+    json << "    \"reflection\": " << total.reflection_rays << ",\n";
+    json << "    \"total\": " << total.totalRays();
+    if (opt.stats){
+        json << ",\n";
+        json << "    \"shadow_triangle_tests\": " << total.shadow_tests << ",\n";
+        json << "    \"shadow_triangle_tests_closest_hit\": " << total.shadow_tests_closest;
+    }
+    json << "\n  },\n";
+    // rays per second of tracing only, the BVH build of the first frame is not included
+    json << "  \"rays_per_second\": " << (traceTotal > 0 ? total.totalRays() / (traceTotal / 1000.0) : 0) << "\n";
+    json << "}\n";
+
+    if (opt.json.empty())
+        cout << json.str();
+    else {
+        ofstream file(opt.json);
+        file << json.str();
+        if (!file){
+            cerr << "ERROR: could not write " << opt.json << endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
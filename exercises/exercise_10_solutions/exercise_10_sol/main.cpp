@@ -79,17 +79,24 @@ int main()
     Primitives::makeCube(2.f, points, normals, uvs, colors);
 
 
-    vector<rt::vertex> vts;
-    glm::mat4 scale = glm::scale(glm::vec3(.25f,.25f,.25f));
+    // the scene is made of instances: the cube mesh is stored once, in its own model space, and placed in the scene
+    // with the transformation of each instance (so more cubes would not take more memory)
+    rt::InstancedScene scene;
+    vector<rt::vertex> cubeVts;
     for (unsigned int i = 0; i < points.size(); i++){
-        rt::vertex v{scale * glm::vec4(points[i], 1.0f),
+        rt::vertex v{glm::vec4(points[i], 1.0f),
                     glm::vec4(normals[i], 0),
                     colors[i],
                     uvs[i]
         };
-        vts.push_back(v);
+        cubeVts.push_back(v);
     }
+    unsigned int cubeMesh = scene.addMesh(cubeVts);
+    scene.addInstance(cubeMesh, glm::scale(glm::vec3(.25f,.25f,.25f)));
 
+    // the room is the cube turned inside out, it is a mesh of its own because its normals must keep pointing
+    // inwards (transforming them with the -2 scale would flip them)
+    vector<rt::vertex> roomVts;
     glm::mat4 outsideout = glm::scale(glm::vec3(-2.f,-2.f,-2.f));
     for (unsigned int i = 0; i < points.size(); i++){
         rt::vertex v{outsideout * glm::vec4(points[i], 1.0f),
@@ -97,8 +104,9 @@ int main()
                      rt::grey,
                      uvs[i]
         };
-        vts.push_back(v);
+        roomVts.push_back(v);
     }
+    scene.addInstance(scene.addMesh(roomVts), glm::mat4(1));
 
 
 
@@ -120,6 +128,8 @@ int main()
     // set texture filtering parameters
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    // allocate it with the size of our buffer, every frame we only upload the regions that changed
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, max_W, max_H, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
 
     // initialize openGL frame buffer object
     // ------------------------------------
@@ -139,6 +149,9 @@ int main()
     std::cout << "3 - two reflections" << std::endl;
     std::cout << "4 - three reflections" << std::endl;
     std::cout << "5 - four reflections" << std::endl;
+    std::cout << "P - toggle progressive rendering (accumulate samples while the camera is static)" << std::endl;
+
+    renderer.progressive = true;
 
     while (!glfwWindowShouldClose(window))
     {
@@ -150,18 +163,23 @@ int main()
 
         // render to our custom frame buffer
         // ---------------------------------
-        customBuffer.clearBuffer(rt::Colors::toRGBA32(rt::Colors::black));
-
+        // no need to clear it, the renderer writes every pixel (and, once a progressive image has converged,
+        // it leaves the buffer as it is)
         glm::mat4 scale = glm::scale(glm::vec3(.5f,.5f,.5f));
 
-        renderer.render(vts, glm::mat4(1), camera.GetViewMatrix(), 70.0f, rtDepth, customBuffer);
+        renderer.render(scene, camera.GetViewMatrix(), 70.0f, rtDepth, customBuffer);
 
         // show our rendered image
         // -----------------------
         // upload the custom color buffer to the GPU using the texture
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, bufferTexture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, max_W, max_H, 0, GL_RGBA, GL_UNSIGNED_BYTE, customBuffer.buffer);
+        // only the tiles that changed since the last frame, the rows of the buffer are max_W pixels long
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, max_W);
+        customBuffer.visitDirtyRects([&](unsigned int x, unsigned int y, unsigned int w, unsigned int h){
+            glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, customBuffer.buffer + x + y * max_W);
+        });
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 
         // set opengl frame buffer object to read from our texture, we will copy from it
         glBindFramebuffer(GL_READ_FRAMEBUFFER, oglFrameBuffer);
@@ -185,7 +203,8 @@ int main()
             elapsed = std::chrono::high_resolution_clock::now() - frameStart;
         }
         deltaTime = elapsed.count();
-        glfwSetWindowTitle(window, ("Exercise 10 - FPS: " + std::to_string(int(1.0f/deltaTime + .5f))).c_str());
+        glfwSetWindowTitle(window, ("Exercise 10 - FPS: " + std::to_string(int(1.0f/deltaTime + .5f)) +
+                                    " - samples: " + std::to_string(renderer.samples())).c_str());
     }
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
@@ -236,6 +255,12 @@ void processInput(GLFWwindow *window) {
     if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS) rtDepth = 4;
     if (glfwGetKey(window, GLFW_KEY_5) == GLFW_PRESS) rtDepth = 5;
 
+    // toggle progressive rendering when the key is pressed (not while it is held down)
+    static bool progressiveKeyDown = false;
+    bool pDown = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+    if (pDown && !progressiveKeyDown) renderer.progressive = !renderer.progressive;
+    progressiveKeyDown = pDown;
+
     // movement commands
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
         camera.ProcessKeyboard(FORWARD, deltaTime);
@@ -5,36 +5,13 @@
 #ifndef ITU_GRAPHICS_PROGRAMMING_FRAME_BUFFER_H
 #define ITU_GRAPHICS_PROGRAMMING_FRAME_BUFFER_H
 
-
-template<class T>
-class FrameBuffer {
-public:
-    unsigned int W, H;
-    T *buffer;
-
-    FrameBuffer(unsigned int width, unsigned int height) : W(width), H(height) {
-        buffer = new T[W * H];
-    }
-
-    ~FrameBuffer() { delete[] buffer; } // clean our memory
-
-    void clearBuffer(T value) {
-        int size = W * H;
-        for (int i = 0; i < size; i++)
-            buffer[i] = value;
-    }
-
-    void paintAt(unsigned int x, unsigned int y, T value) {
-        assert(x < W && y < H); // ensure valid position, crash if not (sooo dramatic!)
-        buffer[x + y * W] = value;
-    }
-
-    T valueAt(unsigned int x, unsigned int y) {
-        assert(x < W && y < H);
-        return buffer[x + y * W];
-    }
-
-};
-
+#include <swr/frame_buffer.h>
+
+// the frame buffer of the rasterizer of exercise 7, with its memory layouts and tile tracking
+using swr::LinearLayout;
+using swr::TiledLayout;
+using swr::MortonLayout;
+template<class T, class Layout = LinearLayout>
+using FrameBuffer = swr::FrameBuffer<T, Layout>;
 
 #endif //ITU_GRAPHICS_PROGRAMMING_FRAME_BUFFER_H
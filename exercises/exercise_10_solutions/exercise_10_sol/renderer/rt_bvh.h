@@ -0,0 +1,296 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_RT_BVH_H
+#define ITU_GRAPHICS_PROGRAMMING_RT_BVH_H
+
+#include <vector>
+#include <cfloat>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "rt_types.h"
+
+namespace rt{
+
+    // axis aligned bounding box
+    struct AABB{
+        glm::vec3 min = glm::vec3(FLT_MAX);
+        glm::vec3 max = glm::vec3(-FLT_MAX);
+
+        void grow(const glm::vec3 &p){
+            min = glm::min(min, p);
+            max = glm::max(max, p);
+        }
+
+        void grow(const AABB &b){
+            min = glm::min(min, b.min);
+            max = glm::max(max, b.max);
+        }
+
+        glm::vec3 centroid() const { return (min + max) * .5f; }
+
+        // half of the surface area, the factor 2 cancels out in the SAH cost anyway
+        float area() const {
+            glm::vec3 e = max - min;
+            return e.x < 0 ? 0 : e.x * e.y + e.y * e.z + e.z * e.x;
+        }
+    };
+
+
+    // bounding volume hierarchy over a list of primitives (triangles or, for instance, other BVHs)
+    // the tree only knows the bounding box of each primitive, testing the primitive itself is left to the caller,
+    // so that the same structure can be used with different geometry representations
+    class BVH{
+    public:
+        struct Node{
+            glm::vec3 min;
+            unsigned int leftFirst; // index of the left child (inner node) or of the first primitive (leaf)
+            glm::vec3 max;
+            unsigned int count;     // number of primitives, 0 for inner nodes
+
+            bool isLeaf() const { return count > 0; }
+        };
+
+        // build the hierarchy using the surface area heuristic (SAH), one box per primitive
+        void build(const std::vector<AABB> &primBounds){
+            nodes.clear();
+            primIndices.resize(primBounds.size());
+            for (unsigned int i = 0; i < primIndices.size(); i++)
+                primIndices[i] = i;
+            if (primBounds.empty()) return;
+
+            // a binary tree with N leaves has 2N-1 nodes
+            nodes.reserve(primBounds.size() * 2);
+            nodes.push_back(Node{});
+            nodes[0].leftFirst = 0;
+            nodes[0].count = (unsigned int) primBounds.size();
+            updateBounds(0, primBounds);
+            subdivide(0, primBounds, 0);
+            build_cost = sahCost();
+        }
+
+        // update the boxes of the nodes after the primitives moved, keeping the structure of the tree.
+        // much faster than build, but the tree gets worse as the primitives move away from where they were when it
+        // was built (compare sahCost with build_cost to decide when to build it again)
+        void refit(const std::vector<AABB> &primBounds){
+            // children are always stored after their parent, so going backwards visits the children first
+            for (size_t n = nodes.size(); n-- > 0;){
+                Node &node = nodes[n];
+                if (node.isLeaf()) {
+                    updateBounds((unsigned int) n, primBounds);
+                    continue;
+                }
+                const Node &left = nodes[node.leftFirst], &right = nodes[node.leftFirst + 1];
+                node.min = glm::min(left.min, right.min);
+                node.max = glm::max(left.max, right.max);
+            }
+        }
+
+        void refit(const std::vector<vertex> &vts){
+            refit(triangleBounds(vts));
+        }
+
+        // expected cost of tracing a ray with this tree according to the SAH (relative to testing one primitive),
+        // the probability of visiting a node is its area divided by the area of the root
+        float sahCost() const {
+            if (nodes.empty()) return 0;
+            const float traversalCost = 1.0f;
+            float cost = 0;
+            for (const Node &node : nodes)
+                cost += AABB{node.min, node.max}.area() * (node.isLeaf() ? (float) node.count : traversalCost);
+            float rootArea = AABB{nodes[0].min, nodes[0].max}.area();
+            return rootArea > 0 ? cost / rootArea : 0;
+        }
+
+        // build the hierarchy over a triangle list, where each three vertices form a triangle
+        void build(const std::vector<vertex> &vts){
+            build(triangleBounds(vts));
+        }
+
+        static std::vector<AABB> triangleBounds(const std::vector<vertex> &vts){
+            std::vector<AABB> bounds(vts.size() / 3);
+            for (unsigned int i = 0; i < bounds.size(); i++){
+                bounds[i].grow(glm::vec3(vts[i * 3].pos));
+                bounds[i].grow(glm::vec3(vts[i * 3 + 1].pos));
+                bounds[i].grow(glm::vec3(vts[i * 3 + 2].pos));
+            }
+            return bounds;
+        }
+
+        bool empty() const { return nodes.empty(); }
+
+        // traverse the tree visiting the closest nodes first.
+        // primTest(primIndex, leafIndex, hit) should test the primitive and, if it is hit closer than hit.dist, update
+        // hit and return true. leafIndex is the position of the primitive in primIndices, data stored in the order of
+        // the leaves can be accessed with it. Nodes further away than hit.dist are skipped, so when looking for any hit closer than a given
+        // distance, hit.dist should be initialized with that distance and anyHit set to true (stops at the first hit).
+        template<typename PrimitiveTest>
+        bool intersect(const Ray &ray, Hit &hit, bool anyHit, PrimitiveTest primTest) const {
+            if (nodes.empty()) return false;
+
+            glm::vec3 invDir = 1.0f / ray.direction;
+            bool found = false;
+
+            // the depth of the tree is limited to maxDepth during the build, so a fixed size stack is enough
+            unsigned int stack[maxDepth];
+            int stackSize = 0;
+            unsigned int nodeIdx = 0;
+
+            if (slabTest(ray.origin, invDir, nodes[0], hit.dist) == FLT_MAX) return false;
+
+            while (true){
+                const Node &node = nodes[nodeIdx];
+                if (node.isLeaf()){
+                    for (unsigned int i = 0; i < node.count; i++){
+                        if (primTest(primIndices[node.leftFirst + i], node.leftFirst + i, hit)){
+                            found = true;
+                            if (anyHit) return true;
+                        }
+                    }
+                }
+                else {
+                    // visit the closest child first, since it is more likely to shorten hit.dist
+                    unsigned int closest = node.leftFirst, furthest = node.leftFirst + 1;
+                    float dClosest = slabTest(ray.origin, invDir, nodes[closest], hit.dist);
+                    float dFurthest = slabTest(ray.origin, invDir, nodes[furthest], hit.dist);
+                    if (dFurthest < dClosest) { std::swap(closest, furthest); std::swap(dClosest, dFurthest); }
+
+                    if (dClosest != FLT_MAX){
+                        if (dFurthest != FLT_MAX) stack[stackSize++] = furthest;
+                        nodeIdx = closest;
+                        continue;
+                    }
+                }
+
+                // pop the next node that is still closer than the closest hit
+                bool popped = false;
+                while (stackSize > 0 && !popped){
+                    nodeIdx = stack[--stackSize];
+                    popped = slabTest(ray.origin, invDir, nodes[nodeIdx], hit.dist) != FLT_MAX;
+                }
+                if (!popped) break;
+            }
+
+            return found;
+        }
+
+        std::vector<Node> nodes;
+        // primitives referenced by the leaves, reordered during the build so that each leaf is a contiguous range
+        std::vector<unsigned int> primIndices;
+
+        // leaves with up to this many primitives are not split if the SAH says it is not worth it
+        unsigned int maxLeafSize = 4;
+
+        // sahCost right after the last build
+        float build_cost = 0;
+
+        // limit to the depth of the tree, so that traversal can use a fixed size stack
+        static const int maxDepth = 64;
+
+    private:
+        static const int numBins = 16;
+
+        // returns the distance to the box or FLT_MAX if the ray misses it (or hits it further than maxDist)
+        static float slabTest(const glm::vec3 &orig, const glm::vec3 &invDir, const Node &node, float maxDist){
+            glm::vec3 t1 = (node.min - orig) * invDir;
+            glm::vec3 t2 = (node.max - orig) * invDir;
+            glm::vec3 tMin = glm::min(t1, t2), tMax = glm::max(t1, t2);
+            float tNear = std::max(std::max(tMin.x, tMin.y), tMin.z);
+            float tFar = std::min(std::min(tMax.x, tMax.y), tMax.z);
+            return (tFar >= tNear && tFar >= 0 && tNear < maxDist) ? tNear : FLT_MAX;
+        }
+
+        void updateBounds(unsigned int nodeIdx, const std::vector<AABB> &primBounds){
+            Node &node = nodes[nodeIdx];
+            AABB box;
+            for (unsigned int i = 0; i < node.count; i++)
+                box.grow(primBounds[primIndices[node.leftFirst + i]]);
+            node.min = box.min;
+            node.max = box.max;
+        }
+
+        // find the best split plane by binning the primitive centroids, returns the SAH cost of the split
+        float findBestSplit(const Node &node, const std::vector<AABB> &primBounds, int &axis, float &splitPos) const {
+            AABB centroidBounds;
+            for (unsigned int i = 0; i < node.count; i++)
+                centroidBounds.grow(primBounds[primIndices[node.leftFirst + i]].centroid());
+
+            float bestCost = FLT_MAX;
+            for (int a = 0; a < 3; a++){
+                float bMin = centroidBounds.min[a], bMax = centroidBounds.max[a];
+                if (bMax - bMin < 1e-7f) continue; // all centroids on the same plane, can't split in this axis
+
+                AABB binBounds[numBins];
+                unsigned int binCount[numBins] = {0};
+                float scale = numBins / (bMax - bMin);
+                for (unsigned int i = 0; i < node.count; i++){
+                    const AABB &b = primBounds[primIndices[node.leftFirst + i]];
+                    int bin = std::min(numBins - 1, (int) ((b.centroid()[a] - bMin) * scale));
+                    binCount[bin]++;
+                    binBounds[bin].grow(b);
+                }
+
+                // sweep from both sides to get the area and count at each of the numBins-1 planes
+                float leftArea[numBins - 1], rightArea[numBins - 1];
+                unsigned int leftCount[numBins - 1], rightCount[numBins - 1];
+                AABB leftBox, rightBox;
+                unsigned int leftSum = 0, rightSum = 0;
+                for (int i = 0; i < numBins - 1; i++){
+                    leftSum += binCount[i];
+                    leftCount[i] = leftSum;
+                    leftBox.grow(binBounds[i]);
+                    leftArea[i] = leftBox.area();
+                    rightSum += binCount[numBins - 1 - i];
+                    rightCount[numBins - 2 - i] = rightSum;
+                    rightBox.grow(binBounds[numBins - 1 - i]);
+                    rightArea[numBins - 2 - i] = rightBox.area();
+                }
+
+                for (int i = 0; i < numBins - 1; i++){
+                    if (leftCount[i] == 0 || rightCount[i] == 0) continue;
+                    float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+                    if (cost < bestCost){
+                        bestCost = cost;
+                        axis = a;
+                        splitPos = bMin + (i + 1) / scale;
+                    }
+                }
+            }
+            return bestCost;
+        }
+
+        void subdivide(unsigned int nodeIdx, const std::vector<AABB> &primBounds, int depth){
+            Node node = nodes[nodeIdx];
+            if (node.count <= 1 || depth >= maxDepth - 1) return;
+
+            int axis = 0;
+            float splitPos = 0;
+            float splitCost = findBestSplit(node, primBounds, axis, splitPos);
+            float leafCost = node.count * AABB{node.min, node.max}.area();
+            if (splitCost == FLT_MAX || (splitCost >= leafCost && node.count <= maxLeafSize)) return;
+
+            // partition the primitives in place, left of the plane at the start of the range
+            int i = node.leftFirst, j = i + node.count - 1;
+            while (i <= j){
+                if (primBounds[primIndices[i]].centroid()[axis] < splitPos) i++;
+                else std::swap(primIndices[i], primIndices[j--]);
+            }
+            unsigned int leftCount = i - node.leftFirst;
+            if (leftCount == 0 || leftCount == node.count) return;
+
+            unsigned int leftIdx = (unsigned int) nodes.size();
+            nodes.push_back(Node{});
+            nodes.push_back(Node{});
+            nodes[leftIdx].leftFirst = node.leftFirst;
+            nodes[leftIdx].count = leftCount;
+            nodes[leftIdx + 1].leftFirst = i;
+            nodes[leftIdx + 1].count = node.count - leftCount;
+            nodes[nodeIdx].leftFirst = leftIdx;
+            nodes[nodeIdx].count = 0;
+
+            updateBounds(leftIdx, primBounds);
+            updateBounds(leftIdx + 1, primBounds);
+            subdivide(leftIdx, primBounds, depth + 1);
+            subdivide(leftIdx + 1, primBounds, depth + 1);
+        }
+    };
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_RT_BVH_H
@@ -0,0 +1,129 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_RT_INSTANCES_H
+#define ITU_GRAPHICS_PROGRAMMING_RT_INSTANCES_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "rt_types.h"
+#include "rt_bvh.h"
+#include "rt_scene.h"
+
+namespace rt{
+
+    // a mesh placed in the scene with a transformation, many instances can share the same mesh
+    struct Instance{
+        unsigned int mesh;
+        glm::mat4 transform;
+        glm::mat4 inverse_transform;
+        glm::mat3 normal_matrix;
+        // replaces the vertex colors of the mesh if use_color is true
+        bool use_color = false;
+        Colors::color col = Colors::white;
+
+        // the ray in the space of the mesh. The direction is not normalized, so that distances along the ray are the
+        // same in both spaces and hits in different instances can be compared
+        Ray toObject(const Ray &ray) const {
+            return Ray(glm::vec3(inverse_transform * glm::vec4(ray.origin, 1)),
+                       glm::vec3(inverse_transform * glm::vec4(ray.direction, 0)));
+        }
+    };
+
+
+    // scene made of instances of meshes, as a two level hierarchy: each mesh is compiled once with its own BVH
+    // (bottom level) and a BVH over the bounding boxes of the instances (top level) finds the instances a ray crosses.
+    // repeated objects don't use more memory than one instance, and moving an instance only rebuilds the top level
+    class InstancedScene{
+    public:
+        // compiles a triangle list (in its own model space) and returns its index
+        unsigned int addMesh(const std::vector<vertex> &vts){
+            meshes.emplace_back();
+            meshes.back().build(vts);
+            modified();
+            return (unsigned int) meshes.size() - 1;
+        }
+
+        // updates a mesh whose vertices moved (same triangles), refitting its BVH (see CompiledScene::refit).
+        // all instances of the mesh change, so the top level is rebuilt in the next update
+        void refitMesh(unsigned int mesh, const std::vector<vertex> &vts, float rebuild_threshold = 1.5f){
+            meshes[mesh].refit(vts, rebuild_threshold);
+            modified();
+        }
+
+        // adds an instance of a mesh and returns its index
+        unsigned int addInstance(unsigned int mesh, const glm::mat4 &transform){
+            instances.emplace_back();
+            instances.back().mesh = mesh;
+            setTransform((unsigned int) instances.size() - 1, transform);
+            return (unsigned int) instances.size() - 1;
+        }
+
+        // same as above, but the instance has the same color everywhere instead of the vertex colors
+        unsigned int addInstance(unsigned int mesh, const glm::mat4 &transform, const Colors::color &col){
+            unsigned int i = addInstance(mesh, transform);
+            instances[i].use_color = true;
+            instances[i].col = col;
+            return i;
+        }
+
+        void setTransform(unsigned int instance, const glm::mat4 &transform){
+            Instance &inst = instances[instance];
+            inst.transform = transform;
+            inst.inverse_transform = glm::inverse(transform);
+            inst.normal_matrix = glm::transpose(glm::mat3(inst.inverse_transform));
+            modified();
+        }
+
+        // rebuilds the top level BVH if instances were added or moved since the last update,
+        // the renderer calls it before rendering the scene
+        void update(){
+            if (!dirty) return;
+            std::vector<AABB> bounds(instances.size());
+            for (unsigned int i = 0; i < instances.size(); i++)
+                bounds[i] = worldBounds(instances[i]);
+            tlas.build(bounds);
+            dirty = false;
+        }
+
+        // changes every time the scene is modified
+        unsigned int version() const { return changes; }
+
+        // number of triangles the scene would have without instancing
+        size_t triangleCount() const {
+            size_t count = 0;
+            for (const Instance &inst : instances)
+                count += meshes[inst.mesh].triangles.size();
+            return count;
+        }
+
+        std::vector<CompiledScene> meshes;
+        std::vector<Instance> instances;
+        // top level hierarchy, its primitives are the instances
+        BVH tlas;
+
+    private:
+        void modified(){
+            dirty = true;
+            changes++;
+        }
+
+        // the box around the bounding box of the mesh transformed to the space of the scene
+        AABB worldBounds(const Instance &inst) const {
+            AABB box;
+            const BVH &blas = meshes[inst.mesh].bvh;
+            if (blas.empty()) {
+                box.grow(glm::vec3(inst.transform[3]));
+                return box;
+            }
+            glm::vec3 corners[2] = {blas.nodes[0].min, blas.nodes[0].max};
+            for (int k = 0; k < 8; k++){
+                glm::vec3 p(corners[k & 1].x, corners[(k >> 1) & 1].y, corners[(k >> 2) & 1].z);
+                box.grow(glm::vec3(inst.transform * glm::vec4(p, 1)));
+            }
+            return box;
+        }
+
+        bool dirty = true;
+        unsigned int changes = 0;
+    };
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_RT_INSTANCES_H
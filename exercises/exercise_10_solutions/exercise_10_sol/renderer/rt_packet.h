@@ -0,0 +1,312 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_RT_PACKET_H
+#define ITU_GRAPHICS_PROGRAMMING_RT_PACKET_H
+
+#include <vector>
+#include <cfloat>
+#include <glm/glm.hpp>
+#include "rt_types.h"
+#include "rt_bvh.h"
+#include "rt_scene.h"
+
+// the packet width depends on the instruction set we compile for:
+// 8 rays with AVX (enable it with the RT_USE_AVX cmake option), 4 rays with SSE2 (always available on x86-64)
+// and 4 rays with plain scalar code on other platforms (RT_PACKET_SIMD == 0, slower than tracing single rays)
+#if defined(__AVX__)
+#include <immintrin.h>
+#define RT_PACKET_AVX
+#define RT_PACKET_WIDTH 8
+#define RT_PACKET_SIMD 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RT_PACKET_SSE
+#define RT_PACKET_WIDTH 4
+#define RT_PACKET_SIMD 1
+#else
+#define RT_PACKET_WIDTH 4
+#define RT_PACKET_SIMD 0
+#endif
+
+namespace rt{
+
+    // N floats/booleans processed with a single instruction, N == RT_PACKET_WIDTH
+    // only the operations needed by the packet intersection are implemented
+#if defined(RT_PACKET_AVX)
+    struct vbool{
+        __m256 m;
+        friend vbool operator&(vbool a, vbool b) { return {_mm256_and_ps(a.m, b.m)}; }
+        friend vbool operator|(vbool a, vbool b) { return {_mm256_or_ps(a.m, b.m)}; }
+        int bits() const { return _mm256_movemask_ps(m); }
+    };
+    struct vfloat{
+        __m256 v;
+        vfloat() = default;
+        vfloat(__m256 x) : v(x) {}
+        vfloat(float x) : v(_mm256_set1_ps(x)) {}
+        static vfloat load(const float *p) { return _mm256_loadu_ps(p); }
+        void store(float *p) const { _mm256_storeu_ps(p, v); }
+        friend vfloat operator+(vfloat a, vfloat b) { return _mm256_add_ps(a.v, b.v); }
+        friend vfloat operator-(vfloat a, vfloat b) { return _mm256_sub_ps(a.v, b.v); }
+        friend vfloat operator*(vfloat a, vfloat b) { return _mm256_mul_ps(a.v, b.v); }
+        friend vfloat operator/(vfloat a, vfloat b) { return _mm256_div_ps(a.v, b.v); }
+        friend vbool operator<(vfloat a, vfloat b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+        friend vbool operator>(vfloat a, vfloat b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)}; }
+        friend vbool operator>=(vfloat a, vfloat b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)}; }
+        friend vbool operator<=(vfloat a, vfloat b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)}; }
+        friend vfloat vmin(vfloat a, vfloat b) { return _mm256_min_ps(a.v, b.v); }
+        friend vfloat vmax(vfloat a, vfloat b) { return _mm256_max_ps(a.v, b.v); }
+        friend vfloat vabs(vfloat a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+        friend vfloat select(vbool m, vfloat a, vfloat b) { return _mm256_blendv_ps(b.v, a.v, m.m); }
+    };
+#elif defined(RT_PACKET_SSE)
+    struct vbool{
+        __m128 m;
+        friend vbool operator&(vbool a, vbool b) { return {_mm_and_ps(a.m, b.m)}; }
+        friend vbool operator|(vbool a, vbool b) { return {_mm_or_ps(a.m, b.m)}; }
+        int bits() const { return _mm_movemask_ps(m); }
+    };
+    struct vfloat{
+        __m128 v;
+        vfloat() = default;
+        vfloat(__m128 x) : v(x) {}
+        vfloat(float x) : v(_mm_set1_ps(x)) {}
+        static vfloat load(const float *p) { return _mm_loadu_ps(p); }
+        void store(float *p) const { _mm_storeu_ps(p, v); }
+        friend vfloat operator+(vfloat a, vfloat b) { return _mm_add_ps(a.v, b.v); }
+        friend vfloat operator-(vfloat a, vfloat b) { return _mm_sub_ps(a.v, b.v); }
+        friend vfloat operator*(vfloat a, vfloat b) { return _mm_mul_ps(a.v, b.v); }
+        friend vfloat operator/(vfloat a, vfloat b) { return _mm_div_ps(a.v, b.v); }
+        friend vbool operator<(vfloat a, vfloat b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+        friend vbool operator>(vfloat a, vfloat b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+        friend vbool operator>=(vfloat a, vfloat b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+        friend vbool operator<=(vfloat a, vfloat b) { return {_mm_cmple_ps(a.v, b.v)}; }
+        friend vfloat vmin(vfloat a, vfloat b) { return _mm_min_ps(a.v, b.v); }
+        friend vfloat vmax(vfloat a, vfloat b) { return _mm_max_ps(a.v, b.v); }
+        friend vfloat vabs(vfloat a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+        // SSE2 has no blend instruction
+        friend vfloat select(vbool m, vfloat a, vfloat b) { return _mm_or_ps(_mm_and_ps(m.m, a.v), _mm_andnot_ps(m.m, b.v)); }
+    };
+#else
+    struct vbool{
+        bool m[RT_PACKET_WIDTH];
+        friend vbool operator&(vbool a, vbool b) { vbool r; for (int i = 0; i < RT_PACKET_WIDTH; i++) r.m[i] = a.m[i] && b.m[i]; return r; }
+        friend vbool operator|(vbool a, vbool b) { vbool r; for (int i = 0; i < RT_PACKET_WIDTH; i++) r.m[i] = a.m[i] || b.m[i]; return r; }
+        int bits() const { int r = 0; for (int i = 0; i < RT_PACKET_WIDTH; i++) r |= int(m[i]) << i; return r; }
+    };
+    struct vfloat{
+        float v[RT_PACKET_WIDTH];
+        vfloat() = default;
+        vfloat(float x) { for (int i = 0; i < RT_PACKET_WIDTH; i++) v[i] = x; }
+        static vfloat load(const float *p) { vfloat r; for (int i = 0; i < RT_PACKET_WIDTH; i++) r.v[i] = p[i]; return r; }
+        void store(float *p) const { for (int i = 0; i < RT_PACKET_WIDTH; i++) p[i] = v[i]; }
+#define RT_VFLOAT_OP(OP) friend vfloat operator OP(vfloat a, vfloat b) { vfloat r; for (int i = 0; i < RT_PACKET_WIDTH; i++) r.v[i] = a.v[i] OP b.v[i]; return r; }
+#define RT_VBOOL_OP(OP) friend vbool operator OP(vfloat a, vfloat b) { vbool r; for (int i = 0; i < RT_PACKET_WIDTH; i++) r.m[i] = a.v[i] OP b.v[i]; return r; }
+        RT_VFLOAT_OP(+) RT_VFLOAT_OP(-) RT_VFLOAT_OP(*) RT_VFLOAT_OP(/)
+        RT_VBOOL_OP(<) RT_VBOOL_OP(>) RT_VBOOL_OP(>=) RT_VBOOL_OP(<=)
+#undef RT_VFLOAT_OP
+#undef RT_VBOOL_OP
+        friend vfloat vmin(vfloat a, vfloat b) { vfloat r; for (int i = 0; i < RT_PACKET_WIDTH; i++) r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return r; }
+        friend vfloat vmax(vfloat a, vfloat b) { vfloat r; for (int i = 0; i < RT_PACKET_WIDTH; i++) r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return r; }
+        friend vfloat vabs(vfloat a) { vfloat r; for (int i = 0; i < RT_PACKET_WIDTH; i++) r.v[i] = a.v[i] < 0 ? -a.v[i] : a.v[i]; return r; }
+        friend vfloat select(vbool m, vfloat a, vfloat b) { vfloat r; for (int i = 0; i < RT_PACKET_WIDTH; i++) r.v[i] = m.m[i] ? a.v[i] : b.v[i]; return r; }
+    };
+#endif
+
+
+    // RT_PACKET_WIDTH rays stored as structure of arrays, so that each component can be loaded in a single vfloat
+    struct RayPacket{
+        float origin[3][RT_PACKET_WIDTH];
+        float direction[3][RT_PACKET_WIDTH];
+        float inv_direction[3][RT_PACKET_WIDTH];
+        bool active[RT_PACKET_WIDTH]; // lanes that are not active (e.g. outside of the image) are ignored
+
+        RayPacket(){
+            for (int lane = 0; lane < RT_PACKET_WIDTH; lane++)
+                set(lane, Ray(glm::vec3(0), glm::vec3(0, 0, -1)));
+            clear();
+        }
+
+        // deactivate all lanes
+        void clear(){
+            for (int lane = 0; lane < RT_PACKET_WIDTH; lane++)
+                active[lane] = false;
+        }
+
+        void set(int lane, const Ray &ray){
+            for (int a = 0; a < 3; a++){
+                origin[a][lane] = ray.origin[a];
+                direction[a][lane] = ray.direction[a];
+                inv_direction[a][lane] = 1.0f / ray.direction[a];
+            }
+            active[lane] = true;
+        }
+
+        Ray get(int lane) const {
+            return Ray(glm::vec3(origin[0][lane], origin[1][lane], origin[2][lane]),
+                       glm::vec3(direction[0][lane], direction[1][lane], direction[2][lane]));
+        }
+    };
+
+    struct HitPacket{
+        float dist[RT_PACKET_WIDTH];
+        float u[RT_PACKET_WIDTH], v[RT_PACKET_WIDTH];
+        int tri[RT_PACKET_WIDTH]; // index of the triangle in the TransposedTriangles, negative for no hit
+
+        HitPacket(){
+            for (int i = 0; i < RT_PACKET_WIDTH; i++){
+                dist[i] = FLT_MAX;
+                u[i] = v[i] = 0;
+                tri[i] = -1;
+            }
+        }
+
+        // the hit of one of the rays, in the format used by the scalar intersection functions
+        Hit get(int lane, const std::vector<unsigned int> &vertex_index) const {
+            Hit hit;
+            if (tri[lane] < 0) return hit;
+            hit.hit_ID = (int) vertex_index[tri[lane]];
+            hit.dist = dist[lane];
+            hit.barycentric = glm::vec3(1.0f - u[lane] - v[lane], u[lane], v[lane]);
+            return hit;
+        }
+    };
+
+
+    // Möller–Trumbore ray-triangle intersection for all rays in the packet against triangle i,
+    // same tests and tolerances as Renderer::rayTriangleIntersection.
+    // returns a bit mask of the lanes that hit the triangle closer than their previous hit
+    inline int packetTriangleIntersection(const RayPacket &rays, vbool active, const TransposedTriangles &tris,
+                                          unsigned int i, HitPacket &hits){
+        const float tolerance = 10e-7f;
+        vfloat dx = vfloat::load(rays.direction[0]), dy = vfloat::load(rays.direction[1]), dz = vfloat::load(rays.direction[2]);
+        vfloat e1x(tris.e1[0][i]), e1y(tris.e1[1][i]), e1z(tris.e1[2][i]);
+        vfloat e2x(tris.e2[0][i]), e2y(tris.e2[1][i]), e2z(tris.e2[2][i]);
+
+        // q = cross(direction, e2)
+        vfloat qx = dy * e2z - dz * e2y, qy = dz * e2x - dx * e2z, qz = dx * e2y - dy * e2x;
+        vfloat a = e1x * qx + e1y * qy + e1z * qz;
+        vbool valid = active & (vabs(a) >= vfloat(tolerance));
+        if (!valid.bits()) return 0;
+
+        vfloat f = vfloat(1.0f) / a;
+        vfloat sx = vfloat::load(rays.origin[0]) - vfloat(tris.v0[0][i]);
+        vfloat sy = vfloat::load(rays.origin[1]) - vfloat(tris.v0[1][i]);
+        vfloat sz = vfloat::load(rays.origin[2]) - vfloat(tris.v0[2][i]);
+        vfloat u = f * (sx * qx + sy * qy + sz * qz);
+        valid = valid & (u >= vfloat(-tolerance));
+
+        // r = cross(s, e1)
+        vfloat rx = sy * e1z - sz * e1y, ry = sz * e1x - sx * e1z, rz = sx * e1y - sy * e1x;
+        vfloat v = f * (dx * rx + dy * ry + dz * rz);
+        valid = valid & (v >= vfloat(-tolerance)) & (u + v <= vfloat(1.0f));
+
+        vfloat t = f * (e2x * rx + e2y * ry + e2z * rz);
+        vfloat dist = vfloat::load(hits.dist);
+        valid = valid & (t >= vfloat(.0f)) & (t < dist);
+
+        int bits = valid.bits();
+        if (!bits) return 0;
+        select(valid, t, dist).store(hits.dist);
+        select(valid, u, vfloat::load(hits.u)).store(hits.u);
+        select(valid, v, vfloat::load(hits.v)).store(hits.v);
+        for (int k = 0; k < RT_PACKET_WIDTH; k++)
+            if (bits & (1 << k)) hits.tri[k] = (int) i;
+        return bits;
+    }
+
+
+    // traversal of the BVH with a packet of rays, the packet visits a node if any of its active rays hits the node box.
+    // with any_hit, a ray is deactivated as soon as it hits a triangle closer than hits.dist (its maximum distance)
+    // and the traversal stops when no ray is left
+    inline void packetTraversal(const RayPacket &rays, const BVH &bvh, const TransposedTriangles &tris,
+                                HitPacket &hits, bool any_hit){
+        if (bvh.nodes.empty()) return;
+
+        float lanes[RT_PACKET_WIDTH];
+        auto activeLanes = [&]() {
+            for (int k = 0; k < RT_PACKET_WIDTH; k++) lanes[k] = rays.active[k] && !(any_hit && hits.tri[k] >= 0) ? 1.0f : .0f;
+            return vfloat::load(lanes) > vfloat(.0f);
+        };
+        vbool active = activeLanes();
+
+        vfloat ox = vfloat::load(rays.origin[0]), oy = vfloat::load(rays.origin[1]), oz = vfloat::load(rays.origin[2]);
+        vfloat ix = vfloat::load(rays.inv_direction[0]), iy = vfloat::load(rays.inv_direction[1]), iz = vfloat::load(rays.inv_direction[2]);
+
+        // returns the closest entry distance among the rays hitting the node, FLT_MAX if none of them do
+        auto slabTest = [&](const BVH::Node &node) {
+            vfloat t1x = (vfloat(node.min.x) - ox) * ix, t2x = (vfloat(node.max.x) - ox) * ix;
+            vfloat t1y = (vfloat(node.min.y) - oy) * iy, t2y = (vfloat(node.max.y) - oy) * iy;
+            vfloat t1z = (vfloat(node.min.z) - oz) * iz, t2z = (vfloat(node.max.z) - oz) * iz;
+            vfloat tNear = vmax(vmax(vmin(t1x, t2x), vmin(t1y, t2y)), vmin(t1z, t2z));
+            vfloat tFar = vmin(vmin(vmax(t1x, t2x), vmax(t1y, t2y)), vmax(t1z, t2z));
+            vbool hit = active & (tFar >= tNear) & (tFar >= vfloat(.0f)) & (tNear < vfloat::load(hits.dist));
+            int bits = hit.bits();
+            if (!bits) return FLT_MAX;
+            float entry[RT_PACKET_WIDTH];
+            tNear.store(entry);
+            float closest = FLT_MAX;
+            for (int k = 0; k < RT_PACKET_WIDTH; k++)
+                if (bits & (1 << k)) closest = std::min(closest, entry[k]);
+            return closest;
+        };
+
+        unsigned int stack[BVH::maxDepth];
+        int stackSize = 0;
+        unsigned int nodeIdx = 0;
+        if (slabTest(bvh.nodes[0]) == FLT_MAX) return;
+
+        while (true){
+            const BVH::Node &node = bvh.nodes[nodeIdx];
+            if (node.isLeaf()){
+                // the transposed triangles are stored in the same order as the leaf primitives
+                int found = 0;
+                for (unsigned int i = node.leftFirst, end = node.leftFirst + node.count; i < end; i++)
+                    found |= packetTriangleIntersection(rays, active, tris, i, hits);
+                if (any_hit && found){
+                    active = activeLanes();
+                    if (!active.bits()) return;
+                }
+            }
+            else {
+                unsigned int closest = node.leftFirst, furthest = node.leftFirst + 1;
+                float dClosest = slabTest(bvh.nodes[closest]);
+                float dFurthest = slabTest(bvh.nodes[furthest]);
+                if (dFurthest < dClosest) { std::swap(closest, furthest); std::swap(dClosest, dFurthest); }
+
+                if (dClosest != FLT_MAX){
+                    if (dFurthest != FLT_MAX) stack[stackSize++] = furthest;
+                    nodeIdx = closest;
+                    continue;
+                }
+            }
+
+            bool popped = false;
+            while (stackSize > 0 && !popped){
+                nodeIdx = stack[--stackSize];
+                popped = slabTest(bvh.nodes[nodeIdx]) != FLT_MAX;
+            }
+            if (!popped) break;
+        }
+    }
+
+
+    // closest hit of every ray of the packet.
+    // this pays off for coherent rays (e.g. neighbouring primary rays), which tend to visit the same nodes
+    inline void packetModelIntersection(const RayPacket &rays, const BVH &bvh, const TransposedTriangles &tris,
+                                        HitPacket &hits){
+        packetTraversal(rays, bvh, tris, hits, false);
+    }
+
+    // occlusion query for every ray of the packet, occluded[k] is true if ray k hits any triangle closer than
+    // max_dist[k]. Shadow rays towards a point light converge, so they are coherent enough for packets
+    inline void packetModelOcclusion(const RayPacket &rays, const BVH &bvh, const TransposedTriangles &tris,
+                                     const float *max_dist, bool *occluded){
+        HitPacket hits;
+        for (int k = 0; k < RT_PACKET_WIDTH; k++)
+            hits.dist[k] = max_dist[k];
+        packetTraversal(rays, bvh, tris, hits, true);
+        for (int k = 0; k < RT_PACKET_WIDTH; k++)
+            occluded[k] = rays.active[k] && hits.tri[k] >= 0;
+    }
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_RT_PACKET_H
@@ -6,68 +6,366 @@
 #define ITU_GRAPHICS_PROGRAMMING_RT_RENDERER_H
 
 #include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <chrono>
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include "rt_types.h"
+#include "rt_color.h"
+#include "rt_bvh.h"
+#include "rt_scene.h"
+#include "rt_instances.h"
+#include "rt_packet.h"
+#include "rt_thread_pool.h"
+#include "rt_texture.h"
 #include "frame_buffer.h"
 
 namespace rt{
     using namespace Colors;
     using namespace glm;
 
+    // counters collected while rendering a frame, the ray-triangle tests only when Renderer::collect_stats is true
+    struct RayStats{
+        unsigned long long primary_rays = 0;
+        unsigned long long reflection_rays = 0;
+        unsigned long long shadow_rays = 0;
+        unsigned long long shadow_rays_occluded = 0;
+        // ray-triangle tests done by the occlusion queries of the shadow rays
+        unsigned long long shadow_tests = 0;
+        // ray-triangle tests that closest hit queries would have done for the same shadow rays,
+        // shadow_tests_closest - shadow_tests is what the early-out saves
+        unsigned long long shadow_tests_closest = 0;
+
+        unsigned long long totalRays() const { return primary_rays + reflection_rays + shadow_rays; }
+
+        RayStats &operator+=(const RayStats &o){
+            primary_rays += o.primary_rays;
+            reflection_rays += o.reflection_rays;
+            shadow_rays += o.shadow_rays;
+            shadow_rays_occluded += o.shadow_rays_occluded;
+            shadow_tests += o.shadow_tests;
+            shadow_tests_closest += o.shadow_tests_closest;
+            return *this;
+        }
+    };
+
+    // time spent in each phase of the last call to Renderer::render, in milliseconds
+    struct FrameTimings{
+        double scene_build_ms = 0; // compiling the vertex list (only when it changes)
+        double trace_ms = 0;       // tracing all tiles
+        double total_ms = 0;
+    };
+
     class Renderer{
         // limits the number of reflections, 1 == no reflection
         const unsigned int max_recursion = 5;
         // mixture parameter for combining local illumination and reflected color
         float p_rg = 0.4f;
 
+        // phong reflection model parameters and the position of the point light (in model space)
+        float ambient = 0.1f, diffuse = 0.5f, specular = 0.5f, shininess = 10;
+        vec3 light_pos = vec3(0, 1.9f, 0);
+
+        // the last vertex list we rendered compiled for ray tracing (acceleration structure, positions and attributes)
+        CompiledScene scene;
+        const vertex *scene_source = nullptr;
+        size_t scene_size = 0;
+        // the vertices moved since the last render, the BVH is refit instead of built again
+        bool scene_moved = false;
+        // angle between the primary rays of two neighbouring pixels, the footprint of a ray grows by it per unit of
+        // distance (a ray cone), which gives the level of detail of the texture at a hit
+        float pixel_spread = 0;
+        // the instanced scene being rendered (only during render), null when rendering a vertex list
+        const InstancedScene *instanced = nullptr;
+        // the last instanced scene we rendered and its version, to know when it changes
+        const InstancedScene *instanced_source = nullptr;
+        unsigned int instanced_version = 0;
+
+        // worker threads used to trace the tiles of the image in parallel, created on the first render
+        std::unique_ptr<ThreadPool> pool;
+
+        // statistics of the last frame, each thread collects its own and adds them here after each tile
+        RayStats frame_stats;
+        FrameTimings frame_timings;
+        std::mutex stats_mutex;
+        static RayStats &threadStats() {
+            thread_local RayStats stats;
+            return stats;
+        }
+
+        // progressive rendering: sum of the colors of all samples taken since the image last changed,
+        // and what was used to render them (if any of these change, the accumulated samples are discarded)
+        std::vector<vec4> accum_buffer;
+        unsigned int accum_samples = 0;
+        mat4 accum_view_to_model = mat4(1);
+        float accum_fov = 0;
+        unsigned int accum_depth = 0;
+        const uint32_t *accum_target = nullptr;
+        unsigned int scene_version = 0, accum_scene_version = 0;
+
+        // wavefront mode: rays waiting to be intersected, each contributes to one pixel of the tile scaled by weight
+        // (the product of the reflection factors along its path)
+        struct WavefrontRay{
+            Ray ray;
+            unsigned int pixel;
+            float weight;
+        };
+        // shadow rays waiting for the occlusion test, light is added to the pixel if the light source is visible
+        struct ShadowRay{
+            Ray ray;
+            float light_dist;
+            unsigned int pixel;
+            color light;
+        };
+        // the queues of each thread, reused by all tiles so that they are only allocated once
+        struct WavefrontQueues{
+            std::vector<WavefrontRay> rays, next_rays;
+            std::vector<Hit> hits;
+            std::vector<ShadowRay> shadow_rays;
+            std::vector<color> colors;
+        };
+        static WavefrontQueues &threadQueues() {
+            thread_local WavefrontQueues queues;
+            return queues;
+        }
+
+        // the colors of the tile a thread is tracing, before and after the conversion to RGBA8, reused by all tiles
+        struct TileBuffers{
+            std::vector<color> linear;
+            std::vector<uint32_t> rgba;
+        };
+        static TileBuffers &threadTileBuffers() {
+            thread_local TileBuffers buffers;
+            return buffers;
+        }
+
+        // radical inverse of index in the given base, used for the low discrepancy subpixel jitter
+        static float halton(unsigned int index, unsigned int base) {
+            float f = 1, r = 0;
+            while (index > 0) {
+                f /= (float) base;
+                r += f * (float) (index % base);
+                index /= base;
+            }
+            return r;
+        }
+
     public:
+        // when false, every ray is tested against every triangle (useful to compare performance and results)
+        bool use_bvh = true;
+        // trace primary rays (all rays in wavefront mode) in packets of RT_PACKET_WIDTH rays using SIMD instructions
+        // (requires use_bvh), off by default when there is no SIMD support
+        bool use_packets = RT_PACKET_SIMD;
+        // number of threads used to render, 0 means one thread per hardware thread
+        unsigned int num_threads = 0;
+        // the image is split in square tiles of tile_size x tile_size pixels, each tile is traced by one thread
+        unsigned int tile_size = 16;
+        // trace each tile bounce by bounce instead of pixel by pixel: all rays of a bounce are intersected together,
+        // then the shadow and reflection rays they spawn are collected in separate queues and intersected in the
+        // next steps. Rays that leave the scene are dropped, so the queues only hold rays that still do work
+        bool wavefront = false;
+        // count the ray-triangle tests done by shadow rays, this also runs a closest hit query for every shadow ray
+        // (for comparison) so it makes rendering slower. The number of rays is always counted.
+        bool collect_stats = false;
+
+        // while the view and the scene don't change, each frame traces one more sample per pixel (with a different
+        // subpixel offset) and shows the average of all samples, so the image converges to an antialiased version
+        bool progressive = false;
+        // once this many samples are accumulated the image is final and render doesn't trace anything
+        unsigned int max_samples = 256;
+
+        // texture that modulates the colors of the surfaces at their uv coordinates, none if null. the level of detail
+        // is the footprint of a pixel at the hit, from the distance along the ray and the slant of the surface
+        const Texture *texture = nullptr;
+        Texture::Filter texture_filter = Texture::trilinear;
+
+        // sRGB encoding and dithering of the colors written to the frame buffer
+        Encoding color_encoding;
+
+        // statistics and timings of the last rendered frame
+        const RayStats &stats() const { return frame_stats; }
+        const FrameTimings &timings() const { return frame_timings; }
+
+        // number of samples per pixel in the image of the last frame
+        unsigned int samples() const { return progressive ? accum_samples : 1; }
+
+        // the scene is compiled again when render is called with a different vertex list (a different data() or
+        // size()), it can't notice edits of the same vector, so call this method if the vertices are modified in place
+        void invalidateScene() {
+            scene_source = nullptr;
+        }
+
+        // call this method instead of invalidateScene when the vertices of the same triangles moved in place
+        // (e.g. an animated mesh), the next render refits the BVH to the new positions, which is much faster than
+        // building it again
+        void refitScene() {
+            scene_moved = true;
+        }
+        // when the refit BVH is expected to be this many times slower to trace than the one built from scratch
+        // (by its SAH cost), it is built again
+        float rebuild_threshold = 1.5f;
+
+        // fb can have any memory layout (see frame_buffer.h), with the tiled layouts each tile of the image is written
+        // to (mostly) contiguous memory
+        template <class Layout>
         void render(const std::vector<vertex> &vts,
                     const glm::mat4 &m,
                     const glm::mat4 &v,
                     const float fov_degrees,
                     unsigned int depth,
-                    FrameBuffer <uint32_t> &fb) {
+                    FrameBuffer <uint32_t, Layout> &fb) {
+            typedef std::chrono::high_resolution_clock clock;
+            auto start = clock::now();
+            frame_stats = RayStats();
+            frame_timings = FrameTimings();
+
+            // the compiled scene is only identified by the storage and length of vts, it goes stale (the old
+            // triangles are still traced) if the vertices are edited in place and neither invalidateScene nor
+            // refitScene is called, or if a new vector happens to reuse the same storage
+            if (scene_source != vts.data() || scene_size != vts.size()) {
+                scene.build(vts);
+                scene_source = vts.data();
+                scene_size = vts.size();
+                scene_version++;
+            }
+            else if (scene_moved) {
+                scene.refit(vts, rebuild_threshold);
+                scene_version++;
+            }
+            scene_moved = false;
+            if (instanced_source) {
+                instanced_source = nullptr;
+                scene_version++;
+            }
 
-            float aspect_ratio = fb.H / fb.W;
-            // we use the fov and the tangent function to compute where is the bottom of the projection plane,
-            // we assume that the projection place is 1 unit in front of the camera (z == -1)
-            float bottom = - tan(abs(radians(fov_degrees)) * 0.5f);
+            renderImage(vts, m, v, fov_degrees, depth, fb, start);
+        }
 
-            // find the transformation that move points from camera space to model space
-            mat4 view_to_model = inverse(v * m);
-            // the bottom left corner of the image plane/camera sensor
-            vec4 lower_left_corner = vec4(bottom * aspect_ratio, bottom, -1, 1);
-            // we transform the camera position (also the convergence point of light rays) from camera coordinates to MODEL coordinates
-            // notice that we implicitly assume that the camera position is at 0,0,0 in its one coordinate space
-            vec4 cam_pos = view_to_model * vec4(0,0,0,1);
+        // renders an instanced scene, its top level hierarchy is rebuilt first if instances were added or moved.
+        // the instance transforms place the meshes in the scene, so there is no model matrix
+        template <class Layout>
+        void render(InstancedScene &instances,
+                    const glm::mat4 &v,
+                    const float fov_degrees,
+                    unsigned int depth,
+                    FrameBuffer <uint32_t, Layout> &fb) {
+            typedef std::chrono::high_resolution_clock clock;
+            auto start = clock::now();
+            frame_stats = RayStats();
+            frame_timings = FrameTimings();
+
+            instances.update();
+            if (instanced_source != &instances || instanced_version != instances.version()) {
+                instanced_source = &instances;
+                instanced_version = instances.version();
+                scene_version++;
+            }
 
-            // the distance from the center of one pixel to the next along the horizontal and vertical axes of the screen
-            // notice that * and / are applied component wise
-            vec2 pixel_size = abs(vec2(lower_left_corner)) * 2.0f / vec2(fb.H, fb.W);
+            instanced = &instances;
+            renderImage(std::vector<vertex>(), mat4(1), v, fov_degrees, depth, fb, start);
+            instanced = nullptr;
+        }
 
+        // traces the rays in queues.rays, and the rays they spawn, up to depth bounces. The color of each pixel is
+        // returned in queues.colors (indexed by WavefrontRay::pixel), it is the same as calling traceRay for every ray
+        void traceWavefront(WavefrontQueues &queues,
+                            unsigned int depth,
+                            bool packets,
+                            const std::vector<vertex> &vts){
+            queues.colors.assign(queues.rays.size(), color(0));
+            RayStats &stats = threadStats();
+
+            for (unsigned int bounce = depth; bounce > 0 && !queues.rays.empty(); bounce--) {
+                // 1. closest hit of all rays of this bounce
+                std::vector<WavefrontRay> &rays = queues.rays;
+                queues.hits.assign(rays.size(), Hit());
+                if (packets) {
+                    for (size_t i = 0; i < rays.size(); i += RT_PACKET_WIDTH) {
+                        RayPacket packet;
+                        unsigned int n = (unsigned int) std::min<size_t>(RT_PACKET_WIDTH, rays.size() - i);
+                        for (unsigned int lane = 0; lane < n; lane++)
+                            packet.set(lane, rays[i + lane].ray);
+                        HitPacket hits;
+                        packetModelIntersection(packet, scene.bvh, scene.triangles, hits);
+                        for (unsigned int lane = 0; lane < n; lane++)
+                            queues.hits[i + lane] = hits.get(lane, scene.triangles.vertex_index);
+                    }
+                }
+                else {
+                    for (size_t i = 0; i < rays.size(); i++)
+                        rayModelIntersection(rays[i].ray, vts, queues.hits[i]);
+                }
 
-            // TODO ex 10.1 iterate through all pixels in the buffer (width: [0, fb.W), height:[0, fb.H])
-            //  for each pixel,
-            //  - find its position in the space of the camera,
-            //  - apply the view_to_model transformation so that we place the pixel in the space of the model
-            //  (do you notice a different pattern? contrary to the typical raster pipeline, it is sometimes cheaper to
-            //  transform from camera space than the other way around -fewer computations-, what is important is that
-            //  all intersection computations should happen in the same space, no matter what that space is)
-            //  - create a ray with the camera origin, and the vector from the camera origin to the pixel you have just found
-            //  - call the TraceRay method using that ray, and store the resulting color in the frame buffer (fb)
-            for (int c = 0; c < fb.W; c++){
-                for(int r = 0; r < fb.H; r++){
-                    vec4 pixel_pos = lower_left_corner + vec4 (vec2(c, r) * pixel_size,0, 0);
-                    pixel_pos = view_to_model * pixel_pos;  // transform from camera coord space to model coord space
-                    Ray ray(cam_pos, normalize(pixel_pos - cam_pos));
-                    color col = traceRay(ray, depth, vts);  // trace te ray / compute the color
-                    fb.paintAt(c, r, toRGBA32(col));        // set the color on the frame buffer
+                // 2. shade the hits, emitting the shadow and reflection rays. Rays that missed are dropped here
+                // (compaction). Surfaces facing away from the light get no direct light, but their shadow rays are
+                // still traced, as traceRay does, so that both modes count the same shadow rays and tests
+                queues.shadow_rays.clear();
+                queues.next_rays.clear();
+                for (size_t i = 0; i < rays.size(); i++) {
+                    const Hit &hit = queues.hits[i];
+                    const WavefrontRay &wr = rays[i];
+                    if (hit.hit_ID < 0) {
+                        queues.colors[wr.pixel] += wr.weight * black;
+                        continue;
+                    }
+                    vec3 i_pos, i_normal;
+                    color i_col;
+                    surfaceAt(wr.ray, hit, i_pos, i_normal, i_col);
+                    queues.colors[wr.pixel] += wr.weight * ambient * i_col;
+
+                    vec3 light_dir = normalize(light_pos - i_pos);
+                    queues.shadow_rays.push_back(ShadowRay{Ray(i_pos + i_normal * .001f, light_dir),
+                                                           length(light_pos - i_pos), wr.pixel,
+                                                           wr.weight * directLight(light_dir, i_normal, i_col)});
+                    if (bounce > 1) {
+                        Ray reflected_ray(i_pos, reflect(wr.ray.direction, i_normal));
+                        reflected_ray.origin -= wr.ray.direction * .001f;
+                        queues.next_rays.push_back(WavefrontRay{reflected_ray, wr.pixel, wr.weight * p_rg});
+                    }
                 }
-            }
 
-        }
+                // 3. occlusion test of the shadow rays
+                std::vector<ShadowRay> &shadow_rays = queues.shadow_rays;
+                if (packets && !collect_stats) {
+                    for (size_t i = 0; i < shadow_rays.size(); i += RT_PACKET_WIDTH) {
+                        RayPacket packet;
+                        float max_dist[RT_PACKET_WIDTH];
+                        bool occluded[RT_PACKET_WIDTH];
+                        unsigned int n = (unsigned int) std::min<size_t>(RT_PACKET_WIDTH, shadow_rays.size() - i);
+                        for (unsigned int lane = 0; lane < n; lane++) {
+                            packet.set(lane, shadow_rays[i + lane].ray);
+                            max_dist[lane] = shadow_rays[i + lane].light_dist;
+                        }
+                        packetModelOcclusion(packet, scene.bvh, scene.triangles, max_dist, occluded);
+                        for (unsigned int lane = 0; lane < n; lane++) {
+                            if (occluded[lane]) stats.shadow_rays_occluded++;
+                            else queues.colors[shadow_rays[i + lane].pixel] += shadow_rays[i + lane].light;
+                        }
+                    }
+                }
+                else {
+                    for (const ShadowRay &sr : shadow_rays) {
+                        bool occluded;
+                        if (collect_stats) {
+                            Hit shadow_hit;
+                            rayModelIntersection(sr.ray, vts, shadow_hit, &stats.shadow_tests_closest);
+                            occluded = rayModelOcclusion(sr.ray, vts, sr.light_dist, &stats.shadow_tests);
+                        }
+                        else
+                            occluded = rayModelOcclusion(sr.ray, vts, sr.light_dist);
+                        if (occluded) stats.shadow_rays_occluded++;
+                        else queues.colors[sr.pixel] += sr.light;
+                    }
+                }
+                stats.shadow_rays += shadow_rays.size();
+                stats.reflection_rays += queues.next_rays.size();
 
+                // 4. the reflection rays are the rays of the next bounce
+                std::swap(queues.rays, queues.next_rays);
+            }
+        }
 
         color traceRay(const Ray & ray,
                        unsigned int depth,
@@ -75,21 +373,24 @@ namespace rt{
             // this is here to ensure we don't end up with a long recursion that can freeze the program (or cause a stack overflow)
             depth = depth > max_recursion ? max_recursion : depth;
 
-            color col = black; // used to output a color
             Hit hitInfo; // used to store the hit information
-            if (!rayModelIntersection(ray, vts, hitInfo)) return col; // no hit, return black
+            if (!rayModelIntersection(ray, vts, hitInfo)) return black; // no hit, return black
 
+            return shade(ray, hitInfo, depth, vts);
+        }
 
-            // TODO ex 10.2 replace the current i_normal and i_col computation with their interpolated versions
-            vec3 i_normal = vts[hitInfo.hit_ID].norm * hitInfo.barycentric.x + vts[hitInfo.hit_ID+1].norm * hitInfo.barycentric.y + vts[hitInfo.hit_ID+2].norm * hitInfo.barycentric.z;
-            i_normal = normalize(i_normal);
-            color i_col = vts[hitInfo.hit_ID].col * hitInfo.barycentric.x + vts[hitInfo.hit_ID+1].col * hitInfo.barycentric.y + vts[hitInfo.hit_ID+2].col * hitInfo.barycentric.z;
+        // compute the color at the intersection point of ray and the model
+        color shade(const Ray & ray,
+                    const Hit & hitInfo,
+                    unsigned int depth,
+                    const std::vector<vertex> &vts){
+            color col = black; // used to output a color
 
-            vec3 i_pos = ray.origin + ray.direction * hitInfo.dist;
+            vec3 i_pos, i_normal;
+            color i_col;
+            surfaceAt(ray, hitInfo, i_pos, i_normal, i_col);
 
             // TODO ex 10.3 implement the phong reflection model for the point light below
-            float ambient = 0.1f, diffuse = 0.5f, specular = 0.5f, shininess = 10;
-            vec3 light_pos(0,1.9f,0); // light position in model space
             vec3 light_dir = normalize(light_pos - i_pos);
 
             col = ambient * i_col;
@@ -97,16 +398,29 @@ namespace rt{
             // TODO ex 10.4 check if the light source is visible from i_pos, we only use the diffuse and specular components if that is the case
             Ray shadow_ray(i_pos + i_normal * .001f, light_dir); // i_normal * .001f is handling numerical precision issues, it prevents self-intersection
             float light_dist = length(light_pos - i_pos);
-            Hit shadow_hit;
-            // check if there is geometry in the direction of the light, and if the closest geometry is closer than the light source
-            if (rayModelIntersection(shadow_ray, vts, shadow_hit) && light_dist < shadow_hit.dist) {
+            // check if there is geometry in the direction of the light closer than the light source,
+            // we don't need the closest intersection for that, any intersection will do.
+            // a shadow ray that hits nothing counts as lit (see rayModelOcclusion)
+            RayStats &stats = threadStats();
+            bool occluded;
+            if (collect_stats) {
+                Hit shadow_hit;
+                rayModelIntersection(shadow_ray, vts, shadow_hit, &stats.shadow_tests_closest);
+                occluded = rayModelOcclusion(shadow_ray, vts, light_dist, &stats.shadow_tests);
+            }
+            else
+                occluded = rayModelOcclusion(shadow_ray, vts, light_dist);
+            stats.shadow_rays++;
+            stats.shadow_rays_occluded += occluded;
+
+            if (!occluded) {
                 // the light is visible from i_pos (there is no occlusion), so we compute direct lighting
-                col += diffuse * i_col * max(dot(light_dir, i_normal), .0f) +
-                       specular * pow(max(dot(light_dir, i_normal), .0f), shininess);
+                col += directLight(light_dir, i_normal, i_col);
             }
 
             // the recursion/reflection happens here!
             if (depth > 1) {
+                stats.reflection_rays++;
                 Ray reflected_ray(i_pos, reflect(ray.direction, i_normal));
                 reflected_ray.origin -= ray.direction * .001f; // this is a small offset to address numerical precision issues
                 // integrate the current color with the reflection color by a p_rg factor
@@ -116,11 +430,194 @@ namespace rt{
             return col;
         }
 
+        // position, normal and color of the surface at the intersection point of ray and the model
+        void surfaceAt(const Ray & ray,
+                       const Hit & hitInfo,
+                       vec3 &i_pos, vec3 &i_normal, color &i_col) const {
+            // TODO ex 10.2 replace the current i_normal and i_col computation with their interpolated versions
+            // the attributes are fetched from the compiled scene (or mesh of the instance hit), only for the triangle that was hit
+            const Instance *inst = hitInfo.instance_ID < 0 ? nullptr : &instanced->instances[hitInfo.instance_ID];
+            const CompiledScene &mesh = inst ? instanced->meshes[inst->mesh] : scene;
+            const TriangleAttributes &tri = mesh.attributesOf(hitInfo);
+            i_normal = tri.norm[0] * hitInfo.barycentric.x + tri.norm[1] * hitInfo.barycentric.y + tri.norm[2] * hitInfo.barycentric.z;
+            if (inst) i_normal = inst->normal_matrix * i_normal;
+            i_normal = normalize(i_normal);
+            i_col = tri.col[0] * hitInfo.barycentric.x + tri.col[1] * hitInfo.barycentric.y + tri.col[2] * hitInfo.barycentric.z;
+            if (inst && inst->use_color) i_col = inst->col;
+
+            if (texture && !texture->empty()) {
+                vec2 uv = tri.uv[0] * hitInfo.barycentric.x + tri.uv[1] * hitInfo.barycentric.y + tri.uv[2] * hitInfo.barycentric.z;
+                // the footprint of the ray cone is wider on surfaces at grazing angles, and the uv density is in the
+                // space of the mesh, so it is scaled by the size of the instance.
+                // distances along reflected rays only count from their origin, so their footprint is underestimated
+                float footprint = pixel_spread * hitInfo.dist / std::max(std::abs(dot(ray.direction, i_normal)), .01f);
+                float density = tri.uv_density;
+                if (inst) density /= std::cbrt(std::abs(determinant(mat3(inst->transform))));
+                float uv_width = footprint * density;
+                i_col *= texture->sample(uv, texture->lod(vec2(uv_width, 0), vec2(0, uv_width)), texture_filter);
+            }
+
+            i_pos = ray.origin + ray.direction * hitInfo.dist;
+        }
+
+        // diffuse and specular components of the phong reflection model, for a surface the light reaches
+        color directLight(const vec3 &light_dir, const vec3 &i_normal, const color &i_col) const {
+            return diffuse * i_col * max(dot(light_dir, i_normal), .0f) +
+                   specular * pow(max(dot(light_dir, i_normal), .0f), shininess);
+        }
+
         // returns false if no intersection
         // intersection results are returned in the "hit" reference variable
-        static bool rayModelIntersection(const Ray & ray,
-                                         const std::vector<vertex> &vts,
-                                         Hit &hit){
+        // the number of ray-triangle tests is added to tests, if provided
+        bool rayModelIntersection(const Ray & ray,
+                                  const std::vector<vertex> &vts,
+                                  Hit &hit,
+                                  unsigned long long *tests = nullptr) const {
+            if (instanced)
+                return instancesIntersection(ray, hit, false, tests);
+
+            if (!use_bvh) {
+                if (tests) *tests += vts.size() / 3;
+                return rayModelIntersectionAll(ray, vts, hit);
+            }
+            return meshIntersection(scene, ray, hit, tests);
+        }
+
+        // occlusion query, returns true if the ray hits any triangle closer than max_dist.
+        // it stops at the first triangle found, it doesn't look for the closest one (e.g. for shadow rays).
+        // the shadow test used to be "the closest hit is beyond the light", so a shadow ray that left the scene
+        // without hitting anything left the surface in shadow. with this query such a surface is lit. nothing changes
+        // in closed scenes like the cornell box, where every shadow ray hits a wall, but in open scenes the surfaces
+        // that see the light with nothing behind it now get their diffuse and specular light
+        // the number of ray-triangle tests is added to tests, if provided
+        bool rayModelOcclusion(const Ray & ray,
+                               const std::vector<vertex> &vts,
+                               float max_dist,
+                               unsigned long long *tests = nullptr) const {
+            if (instanced) {
+                Hit hit;
+                hit.dist = max_dist;
+                return instancesIntersection(ray, hit, true, tests);
+            }
+
+            if (!use_bvh) {
+                float dist_temp;
+                vec3 barycentric_temp;
+                for (size_t i = 0; i < vts.size(); i+=3) {
+                    if (tests) (*tests)++;
+                    if (rayTriangleIntersection(ray, vts[i], vts[i+1], vts[i+2], dist_temp, barycentric_temp) && dist_temp < max_dist)
+                        return true;
+                }
+                return false;
+            }
+            return meshOcclusion(scene, ray, max_dist, tests);
+        }
+
+        // closest hit (or, with any_hit, any hit) of the ray with the instances of the instanced scene, closer than hit.dist.
+        // the top level BVH finds the instances whose box the ray crosses, then the ray is moved to the space of the
+        // mesh of each instance and tested with the BVH of the mesh
+        bool instancesIntersection(const Ray & ray,
+                                   Hit &hit,
+                                   bool any_hit,
+                                   unsigned long long *tests) const {
+            const InstancedScene &s = *instanced;
+            bool bvh = use_bvh;
+            auto instanceTest = [&s, &ray, any_hit, bvh, tests](unsigned int i, unsigned int, Hit &h) {
+                const Instance &inst = s.instances[i];
+                const CompiledScene &mesh = s.meshes[inst.mesh];
+                Ray local = inst.toObject(ray);
+                if (!bvh) {
+                    bool found = meshIntersectionAll(mesh, local, h, tests);
+                    if (found) h.instance_ID = (int) i;
+                    return found;
+                }
+                if (any_hit)
+                    return meshOcclusion(mesh, local, h.dist, tests);
+                if (meshIntersection(mesh, local, h, tests)) {
+                    h.instance_ID = (int) i;
+                    return true;
+                }
+                return false;
+            };
+
+            if (bvh)
+                return s.tlas.intersect(ray, hit, any_hit, instanceTest);
+
+            bool found = false;
+            for (unsigned int i = 0; i < s.instances.size(); i++) {
+                if (instanceTest(i, i, hit)) {
+                    found = true;
+                    if (any_hit) break;
+                }
+            }
+            return found;
+        }
+
+        // closest hit of the ray with a compiled mesh closer than hit.dist, using its BVH.
+        // the BVH only visits the triangles in the boxes crossed by the ray, closest boxes first.
+        // it calls the test with the position of the primitive in the leaves, which is also its index in the
+        // transposed triangles, so only the positions and edges are read here
+        static bool meshIntersection(const CompiledScene &mesh,
+                                     const Ray & ray,
+                                     Hit &hit,
+                                     unsigned long long *tests){
+            const TransposedTriangles &tris = mesh.triangles;
+            return mesh.bvh.intersect(ray, hit, false, [&ray, &tris, tests](unsigned int, unsigned int i, Hit &h) {
+                if (tests) (*tests)++;
+                float dist_temp;
+                vec3 barycentric_temp;
+                if (rayTriangleIntersection(ray, tris.vertex0(i), tris.edge1(i), tris.edge2(i), dist_temp, barycentric_temp) && dist_temp < h.dist) {
+                    h.hit_ID = tris.vertex_index[i];
+                    h.dist = dist_temp;
+                    h.barycentric = barycentric_temp;
+                    return true;
+                }
+                return false;
+            });
+        }
+
+        // occlusion query with a compiled mesh, using its BVH
+        static bool meshOcclusion(const CompiledScene &mesh,
+                                  const Ray & ray,
+                                  float max_dist,
+                                  unsigned long long *tests){
+            float dist_temp;
+            vec3 barycentric_temp;
+            // nodes further than hit.dist are skipped, so the traversal never goes past max_dist
+            Hit hit;
+            hit.dist = max_dist;
+            const TransposedTriangles &tris = mesh.triangles;
+            return mesh.bvh.intersect(ray, hit, true, [&](unsigned int, unsigned int i, Hit &h) {
+                if (tests) (*tests)++;
+                return rayTriangleIntersection(ray, tris.vertex0(i), tris.edge1(i), tris.edge2(i), dist_temp, barycentric_temp) && dist_temp < h.dist;
+            });
+        }
+
+        // brute force version of meshIntersection, tests the ray against all triangles of the mesh
+        static bool meshIntersectionAll(const CompiledScene &mesh,
+                                        const Ray & ray,
+                                        Hit &hit,
+                                        unsigned long long *tests){
+            const TransposedTriangles &tris = mesh.triangles;
+            bool found = false;
+            for (size_t i = 0; i < tris.size(); i++) {
+                if (tests) (*tests)++;
+                float dist_temp;
+                vec3 barycentric_temp;
+                if (rayTriangleIntersection(ray, tris.vertex0(i), tris.edge1(i), tris.edge2(i), dist_temp, barycentric_temp) && dist_temp < hit.dist) {
+                    hit.hit_ID = tris.vertex_index[i];
+                    hit.dist = dist_temp;
+                    hit.barycentric = barycentric_temp;
+                    found = true;
+                }
+            }
+            return found;
+        }
+
+        // brute force version of rayModelIntersection, tests the ray against all triangles
+        static bool rayModelIntersectionAll(const Ray & ray,
+                                            const std::vector<vertex> &vts,
+                                            Hit &hit){
             for (int i = 0; i < vts.size(); i+=3)
             {
                 float dist_temp;
@@ -144,8 +641,16 @@ namespace rt{
                                             const vertex & p3,
                                             float & t, vec3 & barycentric)
         {
-            vec3 e1 = p2.pos - p1.pos;
-            vec3 e2 = p3.pos - p1.pos;
+            return rayTriangleIntersection(ray, vec3(p1.pos), vec3(p2.pos - p1.pos), vec3(p3.pos - p1.pos), t, barycentric);
+        }
+
+        // version of the test above with the two triangle edges already computed (e1 = p2 - p1, e2 = p3 - p1)
+        static bool rayTriangleIntersection(const Ray & ray,
+                                            const vec3 & p1,
+                                            const vec3 & e1,
+                                            const vec3 & e2,
+                                            float & t, vec3 & barycentric)
+        {
             vec3 q = cross(ray.direction, e2);
             float a = dot(e1, q);
 
@@ -154,7 +659,7 @@ namespace rt{
             if (abs(a) < tolerance) return false;
 
             float f = 1.0f / a;
-            vec3 s = ray.origin - vec3(p1.pos);
+            vec3 s = ray.origin - p1;
             float u = f * dot(s, q);
 
             // if u < 0, intersection with plane is not within the triangle
@@ -175,6 +680,184 @@ namespace rt{
 
             return true;
         }
+
+    private:
+        // traces the image of the scene that is being rendered, start is when the call to render started
+        template <class Layout>
+        void renderImage(const std::vector<vertex> &vts,
+                         const glm::mat4 &m,
+                         const glm::mat4 &v,
+                         const float fov_degrees,
+                         unsigned int depth,
+                         FrameBuffer <uint32_t, Layout> &fb,
+                         std::chrono::high_resolution_clock::time_point start) {
+            typedef std::chrono::high_resolution_clock clock;
+            auto scene_end = clock::now();
+            frame_timings.scene_build_ms = std::chrono::duration<double, std::milli>(scene_end - start).count();
+
+            float aspect_ratio = (float) fb.W / (float) fb.H;
+            // we use the fov and the tangent function to compute where is the bottom of the projection plane,
+            // we assume that the projection place is 1 unit in front of the camera (z == -1)
+            float bottom = - tan(abs(radians(fov_degrees)) * 0.5f);
+
+            // find the transformation that move points from camera space to model space
+            mat4 view_to_model = inverse(v * m);
+            // the bottom left corner of the image plane/camera sensor
+            vec4 lower_left_corner = vec4(bottom * aspect_ratio, bottom, -1, 1);
+            // we transform the camera position (also the convergence point of light rays) from camera coordinates to MODEL coordinates
+            // notice that we implicitly assume that the camera position is at 0,0,0 in its one coordinate space
+            vec4 cam_pos = view_to_model * vec4(0,0,0,1);
+
+            // the distance from the center of one pixel to the next along the horizontal and vertical axes of the screen
+            // notice that * and / are applied component wise
+            vec2 pixel_size = abs(vec2(lower_left_corner)) * 2.0f / vec2(fb.W, fb.H);
+            // the projection plane is at distance 1, so the size of a pixel is (close to) the angle between its rays
+            pixel_spread = pixel_size.y;
+
+            depth = depth > max_recursion ? max_recursion : depth;
+
+            // progressive rendering, start accumulating again if anything that affects the image has changed
+            vec2 jitter(0);
+            if (progressive) {
+                if (accum_view_to_model != view_to_model || accum_fov != fov_degrees || accum_depth != depth ||
+                    accum_target != fb.buffer || accum_scene_version != scene_version ||
+                    accum_buffer.size() != fb.W * fb.H) {
+                    accum_buffer.assign(fb.W * fb.H, vec4(0));
+                    accum_samples = 0;
+                    accum_view_to_model = view_to_model;
+                    accum_fov = fov_degrees;
+                    accum_depth = depth;
+                    accum_target = fb.buffer;
+                    accum_scene_version = scene_version;
+                }
+                // the image has converged, the frame buffer already has it
+                if (accum_samples >= max_samples) {
+                    frame_timings.total_ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+                    return;
+                }
+                // the first sample is at the same position as in the non-progressive mode, the following ones are
+                // spread over the pixel area
+                jitter = vec2(halton(accum_samples, 2), halton(accum_samples, 3));
+                accum_samples++;
+            }
+            else if (!accum_buffer.empty()) {
+                accum_buffer = std::vector<vec4>();
+                accum_samples = 0;
+            }
+            float inv_samples = progressive ? 1.0f / (float) accum_samples : 1.0f;
+
+
+            // TODO ex 10.1 iterate through all pixels in the buffer (width: [0, fb.W), height:[0, fb.H])
+            //  for each pixel,
+            //  - find its position in the space of the camera,
+            //  - apply the view_to_model transformation so that we place the pixel in the space of the model
+            //  (do you notice a different pattern? contrary to the typical raster pipeline, it is sometimes cheaper to
+            //  transform from camera space than the other way around -fewer computations-, what is important is that
+            //  all intersection computations should happen in the same space, no matter what that space is)
+            //  - create a ray with the camera origin, and the vector from the camera origin to the pixel you have just found
+            //  - call the TraceRay method using that ray, and store the resulting color in the frame buffer (fb)
+            auto primaryRay = [&](unsigned int c, unsigned int r) {
+                vec4 pixel_pos = lower_left_corner + vec4 ((vec2(c, r) + jitter) * pixel_size,0, 0);
+                pixel_pos = view_to_model * pixel_pos;  // transform from camera coord space to model coord space
+                return Ray(cam_pos, normalize(pixel_pos - cam_pos));
+            };
+            // the packet traversal only supports a single level hierarchy, instanced scenes trace rays one by one
+            bool packets = use_packets && use_bvh && !instanced;
+
+            // the image is traced in tiles, which are distributed among the threads of the pool
+            unsigned int threads = num_threads > 0 ? num_threads : std::max(1u, std::thread::hardware_concurrency());
+            if (!pool || pool->size() != threads)
+                pool.reset(new ThreadPool(threads));
+
+            unsigned int tiles_x = (fb.W + tile_size - 1) / tile_size;
+            unsigned int tiles_y = (fb.H + tile_size - 1) / tile_size;
+
+            // every pixel is written, so a fast clear of fb is dropped without filling it. this is done here because
+            // the tiles of the frame buffer can be shared by the tiles of two threads
+            fb.prepareWrite(0, 0, fb.W - 1, fb.H - 1, true);
+
+            pool->parallelFor(tiles_x * tiles_y, [&](unsigned int tile) {
+                unsigned int c0 = (tile % tiles_x) * tile_size, r0 = (tile / tiles_x) * tile_size;
+                unsigned int c1 = std::min(c0 + tile_size, fb.W), r1 = std::min(r0 + tile_size, fb.H);
+
+                // the colors are stored in a buffer owned by this thread and written to the frame buffer when the tile
+                // is finished (converted to RGBA8 a row at a time, see Colors::toRGBA32), so threads don't keep writing
+                // to cache lines shared with other tiles
+                TileBuffers &buffers = threadTileBuffers();
+                std::vector<color> &tile_linear = buffers.linear;
+                tile_linear.resize((c1 - c0) * (r1 - r0));
+                auto output = [&](unsigned int c, unsigned int r, color col) {
+                    if (progressive) {
+                        // average with the previous samples of the pixel (clamped, since that is what is displayed)
+                        vec4 &sum = accum_buffer[c + r * fb.W];
+                        sum += clamp(col, .0f, 1.0f);
+                        col = sum * inv_samples;
+                    }
+                    tile_linear[(c - c0) + (r - r0) * (c1 - c0)] = col;
+                };
+                if (wavefront) {
+                    WavefrontQueues &queues = threadQueues();
+                    queues.rays.clear();
+                    for (unsigned int r = r0; r < r1; r++)
+                        for (unsigned int c = c0; c < c1; c++)
+                            queues.rays.push_back(WavefrontRay{primaryRay(c, r), (c - c0) + (r - r0) * (c1 - c0), 1.0f});
+                    traceWavefront(queues, depth, packets, vts);
+                    for (unsigned int r = r0; r < r1; r++)
+                        for (unsigned int c = c0; c < c1; c++)
+                            output(c, r, queues.colors[(c - c0) + (r - r0) * (c1 - c0)]);
+                }
+                else for (unsigned int r = r0; r < r1; r++){
+                    if (packets) {
+                        // neighbouring pixels in a row go in the same packet, they visit mostly the same BVH nodes
+                        for (unsigned int c = c0; c < c1; c += RT_PACKET_WIDTH){
+                            RayPacket packet;
+                            for (unsigned int lane = 0; lane < RT_PACKET_WIDTH && c + lane < c1; lane++)
+                                packet.set(lane, primaryRay(c + lane, r));
+                            HitPacket hits;
+                            packetModelIntersection(packet, scene.bvh, scene.triangles, hits);
+
+                            // secondary rays are not coherent, so shading (shadows and reflections) is done per ray
+                            for (unsigned int lane = 0; lane < RT_PACKET_WIDTH && c + lane < c1; lane++){
+                                Hit hit = hits.get(lane, scene.triangles.vertex_index);
+                                color col = hit.hit_ID < 0 ? black : shade(packet.get(lane), hit, depth, vts);
+                                output(c + lane, r, col);
+                            }
+                        }
+                        continue;
+                    }
+                    for (unsigned int c = c0; c < c1; c++){
+                        Ray ray = primaryRay(c, r);
+                        color col = traceRay(ray, depth, vts);  // trace te ray / compute the color
+                        output(c, r, col);
+                    }
+                }
+                // the rows of the linear layout are contiguous in the frame buffer too, so they are converted in place
+                if (Layout::block_size == 0) {
+                    for (unsigned int r = r0; r < r1; r++)
+                        toRGBA32(&tile_linear[(r - r0) * (c1 - c0)], &fb.buffer[fb.indexOf(c0, r)], c1 - c0, color_encoding, c0, r);
+                }
+                else {
+                    std::vector<uint32_t> &tile_colors = buffers.rgba;
+                    tile_colors.resize((c1 - c0) * (r1 - r0));
+                    for (unsigned int r = r0; r < r1; r++)
+                        toRGBA32(&tile_linear[(r - r0) * (c1 - c0)], &tile_colors[(r - r0) * (c1 - c0)], c1 - c0,
+                                 color_encoding, c0, r);
+                    fb.visitRect(c0, r0, c1 - 1, r1 - 1, [&](unsigned int c, unsigned int r, uint32_t &pixel) {
+                        pixel = tile_colors[(c - c0) + (r - r0) * (c1 - c0)];
+                    });
+                }
+
+                RayStats &stats = threadStats();
+                stats.primary_rays += (c1 - c0) * (r1 - r0);
+                std::lock_guard<std::mutex> lock(stats_mutex);
+                frame_stats += stats;
+                stats = RayStats();
+            });
+
+            auto end = clock::now();
+            frame_timings.trace_ms = std::chrono::duration<double, std::milli>(end - scene_end).count();
+            frame_timings.total_ms = std::chrono::duration<double, std::milli>(end - start).count();
+        }
     };
 }
 
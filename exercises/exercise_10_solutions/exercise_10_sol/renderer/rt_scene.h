@@ -0,0 +1,110 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_RT_SCENE_H
+#define ITU_GRAPHICS_PROGRAMMING_RT_SCENE_H
+
+#include <vector>
+#include <cmath>
+#include <glm/glm.hpp>
+#include "rt_types.h"
+#include "rt_bvh.h"
+
+namespace rt{
+
+    // triangle positions stored as structure of arrays in the order of the BVH leaves, with the two edges used by the
+    // Möller–Trumbore test already computed. This is the only data read while searching for an intersection.
+    struct TransposedTriangles{
+        std::vector<float> v0[3], e1[3], e2[3];
+        std::vector<unsigned int> vertex_index; // index of the first vertex of the triangle in the vertex list
+
+        void build(const std::vector<vertex> &vts, const BVH &bvh){
+            size_t n = bvh.primIndices.size();
+            for (int a = 0; a < 3; a++){
+                v0[a].resize(n); e1[a].resize(n); e2[a].resize(n);
+            }
+            vertex_index.resize(n);
+            for (size_t i = 0; i < n; i++){
+                unsigned int vi = bvh.primIndices[i] * 3;
+                for (int a = 0; a < 3; a++){
+                    v0[a][i] = vts[vi].pos[a];
+                    e1[a][i] = vts[vi + 1].pos[a] - vts[vi].pos[a];
+                    e2[a][i] = vts[vi + 2].pos[a] - vts[vi].pos[a];
+                }
+                vertex_index[i] = vi;
+            }
+        }
+
+        glm::vec3 vertex0(size_t i) const { return glm::vec3(v0[0][i], v0[1][i], v0[2][i]); }
+        glm::vec3 edge1(size_t i) const { return glm::vec3(e1[0][i], e1[1][i], e1[2][i]); }
+        glm::vec3 edge2(size_t i) const { return glm::vec3(e2[0][i], e2[1][i], e2[2][i]); }
+
+        size_t size() const { return vertex_index.size(); }
+    };
+
+
+    // the vertex data needed to shade a triangle, only read once we know which triangle is the closest hit
+    struct TriangleAttributes{
+        glm::vec3 norm[3];
+        Colors::color col[3];
+        glm::vec2 uv[3];
+        // change of the texture coordinates per unit of length on the triangle, sqrt(uv area / area), used to find the
+        // level of detail of a texture from the footprint of a ray
+        float uv_density;
+    };
+
+
+    // a vertex list compiled to the representation used by the ray tracer:
+    // the BVH, the positions used for intersection and, separately, the attributes used for shading
+    struct CompiledScene{
+        BVH bvh;
+        TransposedTriangles triangles;
+        // in the order of the vertex list, the attributes of the triangle hit are at attributes[hit.hit_ID / 3]
+        std::vector<TriangleAttributes> attributes;
+
+        void build(const std::vector<vertex> &vts){
+            bvh.build(vts);
+            triangles.build(vts, bvh);
+            buildAttributes(vts);
+        }
+
+        // update the scene after the vertices moved (same number of triangles), refitting the BVH instead of building
+        // it again. If the refit tree is expected to be more than rebuild_threshold times slower to trace than a new
+        // one (by its SAH cost), it is built again. Returns true if it was built again
+        bool refit(const std::vector<vertex> &vts, float rebuild_threshold){
+            if (vts.size() / 3 != triangles.size() || bvh.empty()){
+                build(vts);
+                return true;
+            }
+            bvh.refit(vts);
+            if (bvh.sahCost() > bvh.build_cost * rebuild_threshold){
+                build(vts);
+                return true;
+            }
+            triangles.build(vts, bvh);
+            buildAttributes(vts);
+            return false;
+        }
+
+        const TriangleAttributes &attributesOf(const Hit &hit) const {
+            return attributes[hit.hit_ID / 3];
+        }
+
+    private:
+        void buildAttributes(const std::vector<vertex> &vts){
+            attributes.resize(vts.size() / 3);
+            for (size_t t = 0; t < attributes.size(); t++){
+                for (int k = 0; k < 3; k++){
+                    const vertex &v = vts[t * 3 + k];
+                    attributes[t].norm[k] = glm::vec3(v.norm);
+                    attributes[t].col[k] = v.col;
+                    attributes[t].uv[k] = v.uv;
+                }
+                const vertex *tv = &vts[t * 3];
+                glm::vec2 duv1 = tv[1].uv - tv[0].uv, duv2 = tv[2].uv - tv[0].uv;
+                float uv_area = std::abs(duv1.x * duv2.y - duv1.y * duv2.x);
+                float area = glm::length(glm::cross(glm::vec3(tv[1].pos - tv[0].pos), glm::vec3(tv[2].pos - tv[0].pos)));
+                attributes[t].uv_density = area > 0 ? std::sqrt(uv_area / area) : 0;
+            }
+        }
+    };
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_RT_SCENE_H
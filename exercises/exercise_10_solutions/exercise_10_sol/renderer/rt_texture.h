@@ -0,0 +1,11 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_RT_TEXTURE_H
+#define ITU_GRAPHICS_PROGRAMMING_RT_TEXTURE_H
+
+#include <swr/texture.h>
+
+namespace rt {
+    // the mipmapped texture is shared with the rasterizer of exercise 7
+    using swr::Texture;
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_RT_TEXTURE_H
@@ -0,0 +1,141 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_RT_THREAD_POOL_H
+#define ITU_GRAPHICS_PROGRAMMING_RT_THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+
+namespace rt{
+
+    // a pool of persistent worker threads with one work queue per thread.
+    // each thread consumes its own queue from the front and, when it runs out of work, steals from the back of the
+    // queues of the other threads, so that expensive items (e.g. tiles with many reflections) don't leave cores idle
+    class ThreadPool{
+    public:
+        // numThreads includes the thread calling parallelFor, which also does work
+        explicit ThreadPool(unsigned int numThreads) {
+            if (numThreads == 0) numThreads = 1;
+            for (unsigned int i = 0; i < numThreads; i++)
+                queues.emplace_back(new WorkQueue());
+            for (unsigned int i = 1; i < numThreads; i++)
+                workers.emplace_back(&ThreadPool::workerLoop, this, i);
+        }
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            wakeUp.notify_all();
+            for (auto &w : workers)
+                w.join();
+        }
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        unsigned int size() const { return (unsigned int) queues.size(); }
+
+        // calls task(i) for every i in [0, count) using all threads, and returns when all calls are done.
+        // it must not be called from inside a task
+        void parallelFor(unsigned int count, const std::function<void(unsigned int)> &task) {
+            if (workers.empty() || count <= 1) {
+                for (unsigned int i = 0; i < count; i++)
+                    task(i);
+                return;
+            }
+
+            // give each thread a contiguous range of items, neighbouring items (tiles) tend to have similar cost
+            unsigned int n = size();
+            for (unsigned int q = 0; q < n; q++) {
+                std::lock_guard<std::mutex> lock(queues[q]->mutex);
+                queues[q]->items.clear();
+                for (unsigned int i = count * q / n, end = count * (q + 1) / n; i < end; i++)
+                    queues[q]->items.push_back(i);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                job = &task;
+                busyWorkers = (unsigned int) workers.size();
+                generation++;
+            }
+            wakeUp.notify_all();
+
+            // the calling thread is worker 0
+            work(0);
+
+            std::unique_lock<std::mutex> lock(mutex);
+            allDone.wait(lock, [this] { return busyWorkers == 0; });
+            job = nullptr;
+        }
+
+    private:
+        // padded so that two queues (allocated separately) never share a cache line
+        struct WorkQueue{
+            std::mutex mutex;
+            std::deque<unsigned int> items;
+            char padding[64];
+        };
+
+        bool popFront(unsigned int q, unsigned int &item) {
+            std::lock_guard<std::mutex> lock(queues[q]->mutex);
+            if (queues[q]->items.empty()) return false;
+            item = queues[q]->items.front();
+            queues[q]->items.pop_front();
+            return true;
+        }
+
+        bool stealBack(unsigned int thief, unsigned int &item) {
+            for (unsigned int i = 1, n = size(); i < n; i++) {
+                unsigned int q = (thief + i) % n;
+                std::lock_guard<std::mutex> lock(queues[q]->mutex);
+                if (queues[q]->items.empty()) continue;
+                item = queues[q]->items.back();
+                queues[q]->items.pop_back();
+                return true;
+            }
+            return false;
+        }
+
+        void work(unsigned int id) {
+            unsigned int item;
+            while (popFront(id, item) || stealBack(id, item))
+                (*job)(item);
+        }
+
+        void workerLoop(unsigned int id) {
+            unsigned int seenGeneration = 0;
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wakeUp.wait(lock, [&] { return stop || generation != seenGeneration; });
+                    if (stop) return;
+                    seenGeneration = generation;
+                }
+
+                work(id);
+
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--busyWorkers == 0)
+                    allDone.notify_one();
+            }
+        }
+
+        std::vector<std::unique_ptr<WorkQueue>> queues;
+        std::vector<std::thread> workers;
+
+        std::mutex mutex;
+        std::condition_variable wakeUp, allDone;
+        const std::function<void(unsigned int)> *job = nullptr;
+        unsigned int generation = 0;
+        unsigned int busyWorkers = 0;
+        bool stop = false;
+    };
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_RT_THREAD_POOL_H
@@ -40,6 +40,7 @@ namespace rt{
         int hit_ID = -1; // negative values for no hit, other values for the index of the first vertex in a triangle
         glm::vec3 barycentric; // the barycentric coordinates of the triangle that was hit (if any)
         float dist = FLT_MAX;  // used to store the intersection distance
+        int instance_ID = -1;  // the instance hit when rendering an rt::InstancedScene, -1 otherwise
     };
 
     struct vertex {
@@ -8,6 +8,7 @@
 #include "srl_point_renderer.h"
 #include "srl_line_renderer.h"
 #include "srl_triangle_renderer.h"
+#include "srl_binning_renderer.h"
 #include "primitives.h"
 
 // glfw callbacks
@@ -32,7 +33,13 @@ const unsigned int SCR_HEIGHT = 800;
 srl::PointRenderer pRenderer;
 srl::LineRenderer lRenderer;
 srl::TriangleRenderer tRenderer;
+srl::BinningRenderer bRenderer;
+// binning renderer with a checkerboard texture modulating the vertex colors
+srl::Texture checkerTexture;
+srl::ShadedBinningRenderer<srl::TexturedShader> texRenderer;
 srl::Renderer* srlRenderer = &tRenderer;
+// samples of the triangle renderers in the 4x MSAA mode (key M)
+srl::MultisampleBuffer msaaBuffer(max_W, max_H);
 
 int main()
 {
@@ -90,6 +97,16 @@ int main()
         vtsCube.push_back(v);
     }
 
+    // checkerboard of 8x8 texels, with a darker line at the border of each square so that aliasing is easy to see
+    std::vector<std::uint32_t> texels(256 * 256);
+    for (int y = 0; y < 256; y++)
+        for (int x = 0; x < 256; x++)
+            texels[y * 256 + x] = (x % 8 == 0 || y % 8 == 0) ? srl::Colors::toRGBA32(srl::Colors::dark) :
+                                  ((x / 8 + y / 8) % 2 ? srl::Colors::toRGBA32(srl::Colors::white) :
+                                                         srl::Colors::toRGBA32(srl::Colors::grey));
+    checkerTexture.load(256, 256, texels.data());
+    texRenderer.shader().m_texture = &checkerTexture;
+
 
     // camera
     // ------
@@ -120,6 +137,8 @@ int main()
     // set texture filtering parameters
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    // allocate it with the size of our buffer, every frame we only upload the regions that changed
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, max_W, max_H, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
 
     // initialize openGL frame buffer object
     // ------------------------------------
@@ -137,6 +156,17 @@ int main()
     std::cout << "1 - use point renderer" << std::endl;
     std::cout << "2 - use line renderer" << std::endl;
     std::cout << "3 - use triangle renderer" << std::endl;
+    std::cout << "4 - use multithreaded (binning) triangle renderer" << std::endl;
+    std::cout << "5 - use textured multithreaded (binning) triangle renderer" << std::endl;
+    std::cout << "T - cycle nearest, bilinear and trilinear texture filtering (textured renderer)" << std::endl;
+    std::cout << "B - toggle block rasterizer (triangle renderer)" << std::endl;
+    std::cout << "F - toggle fused rasterization and depth test (triangle renderer)" << std::endl;
+    std::cout << "Z - toggle hierarchical z buffer (fused block rasterization and binning renderer)" << std::endl;
+    std::cout << "G - toggle guard band clipping (triangle renderers)" << std::endl;
+    std::cout << "S - toggle subpixel precision and top-left fill rule (triangle renderers)" << std::endl;
+    std::cout << "M - toggle 4x multisample anti-aliasing (triangle renderers)" << std::endl;
+    std::cout << "E - toggle sRGB encoding of the colors" << std::endl;
+    std::cout << "D - toggle ordered dithering of the colors" << std::endl;
 
     while (!glfwWindowShouldClose(window))
     {
@@ -150,14 +180,28 @@ int main()
         customBuffer.clearBuffer(srl::Colors::toRGBA32(srl::Colors::black));
         customZBuffer.clearBuffer(1.0f);
 
+        // the triangle renderers draw to the samples of the MSAA buffer, which are averaged into our frame buffer
+        bool multisample = tRenderer.m_multisample &&
+                           (srlRenderer == &tRenderer || srlRenderer == &bRenderer || srlRenderer == &texRenderer);
+        if (multisample)
+            msaaBuffer.clear(srl::Colors::toRGBA32(srl::Colors::black), 1.0f);
+
         srlRenderer->render(vtsCube, trackballRotation() * storedRotation, viewProj, customBuffer, customZBuffer);
 
+        if (multisample)
+            msaaBuffer.resolve(customBuffer, tRenderer.m_colorEncoding);
+
         // show our rendered image
         // -----------------------
         // upload the custom color buffer to the GPU using the texture
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, bufferTexture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, max_W, max_H, 0, GL_RGBA, GL_UNSIGNED_BYTE, customBuffer.buffer);
+        // only the tiles that changed since the last frame, the rows of the buffer are max_W pixels long
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, max_W);
+        customBuffer.visitDirtyRects([&](unsigned int x, unsigned int y, unsigned int w, unsigned int h){
+            glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, customBuffer.buffer + x + y * max_W);
+        });
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 
         // set opengl frame buffer object to read from our texture, we will copy from it
         glBindFramebuffer(GL_READ_FRAMEBUFFER, oglFrameBuffer);
@@ -268,6 +312,55 @@ void key_input_callback(GLFWwindow* window, int button, int other,int action, in
     if (button == GLFW_KEY_3 && action == GLFW_PRESS){
         srlRenderer = &tRenderer;
     }
+    if (button == GLFW_KEY_4 && action == GLFW_PRESS){
+        srlRenderer = &bRenderer;
+    }
+    if (button == GLFW_KEY_5 && action == GLFW_PRESS){
+        srlRenderer = &texRenderer;
+    }
+    if (button == GLFW_KEY_T && action == GLFW_PRESS){
+        srl::Texture::Filter &filter = texRenderer.shader().m_filter;
+        filter = srl::Texture::Filter((filter + 1) % 3);
+        const char *names[] = {"nearest", "bilinear", "trilinear"};
+        std::cout << names[filter] << " texture filtering" << std::endl;
+    }
+    if (button == GLFW_KEY_B && action == GLFW_PRESS){
+        tRenderer.m_useBlockRasterizer = !tRenderer.m_useBlockRasterizer;
+        std::cout << (tRenderer.m_useBlockRasterizer ? "block" : "scanline") << " rasterizer" << std::endl;
+    }
+    if (button == GLFW_KEY_F && action == GLFW_PRESS){
+        tRenderer.m_streaming = !tRenderer.m_streaming;
+        std::cout << (tRenderer.m_streaming ? "fused" : "fragment stream") << " pipeline" << std::endl;
+    }
+    if (button == GLFW_KEY_Z && action == GLFW_PRESS){
+        tRenderer.m_hierarchicalZ = bRenderer.m_hierarchicalZ = texRenderer.m_hierarchicalZ = !tRenderer.m_hierarchicalZ;
+        std::cout << "hierarchical z buffer " << (tRenderer.m_hierarchicalZ ? "on" : "off") << std::endl;
+    }
+    if (button == GLFW_KEY_G && action == GLFW_PRESS){
+        tRenderer.m_guardBandClipping = bRenderer.m_guardBandClipping = texRenderer.m_guardBandClipping =
+                !tRenderer.m_guardBandClipping;
+        std::cout << (tRenderer.m_guardBandClipping ? "guard band" : "frustum") << " clipping" << std::endl;
+    }
+    if (button == GLFW_KEY_S && action == GLFW_PRESS){
+        tRenderer.m_subpixelPrecision = bRenderer.m_subpixelPrecision = texRenderer.m_subpixelPrecision =
+                !tRenderer.m_subpixelPrecision;
+        std::cout << (tRenderer.m_subpixelPrecision ? "subpixel" : "whole pixel") << " vertex precision" << std::endl;
+    }
+    if (button == GLFW_KEY_M && action == GLFW_PRESS){
+        tRenderer.m_multisample = bRenderer.m_multisample = texRenderer.m_multisample =
+                tRenderer.m_multisample ? nullptr : &msaaBuffer;
+        std::cout << "4x multisample anti-aliasing " << (tRenderer.m_multisample ? "on" : "off") << std::endl;
+    }
+    if (button == GLFW_KEY_E && action == GLFW_PRESS){
+        pRenderer.m_colorEncoding.srgb = lRenderer.m_colorEncoding.srgb = tRenderer.m_colorEncoding.srgb =
+                bRenderer.m_colorEncoding.srgb = texRenderer.m_colorEncoding.srgb = !tRenderer.m_colorEncoding.srgb;
+        std::cout << "sRGB encoding " << (tRenderer.m_colorEncoding.srgb ? "on" : "off") << std::endl;
+    }
+    if (button == GLFW_KEY_D && action == GLFW_PRESS){
+        pRenderer.m_colorEncoding.dither = lRenderer.m_colorEncoding.dither = tRenderer.m_colorEncoding.dither =
+                bRenderer.m_colorEncoding.dither = texRenderer.m_colorEncoding.dither = !tRenderer.m_colorEncoding.dither;
+        std::cout << "ordered dithering " << (tRenderer.m_colorEncoding.dither ? "on" : "off") << std::endl;
+    }
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -0,0 +1,380 @@
+#include "blockrasterizer.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+/*
+ * \class block_rasterizer
+ * A class which scanconverts a triangle with edge functions evaluated over blocks of 8x8 pixels.
+ */
+block_rasterizer::block_rasterizer(int x1, int y1, int x2, int y2, int x3, int y3, int width, int height)
+    : valid(false)
+{
+    this->initialize_triangle(x1, y1, x2, y2, x3, y3, 0, false, nullptr, 1, 0, 0, width - 1, height - 1);
+}
+
+/*
+ * Creates a block rasterizer which only covers the pixels inside of the rectangle [rect_x_min, rect_x_max] x
+ * [rect_y_min, rect_y_max]
+ */
+block_rasterizer::block_rasterizer(int x1, int y1, int x2, int y2, int x3, int y3,
+                                   int rect_x_min, int rect_y_min, int rect_x_max, int rect_y_max)
+    : valid(false)
+{
+    this->initialize_triangle(x1, y1, x2, y2, x3, y3, 0, false, nullptr, 1, rect_x_min, rect_y_min, rect_x_max, rect_y_max);
+}
+
+/*
+ * Creates a block rasterizer with subpixel precision, the vertices are in fixed point with subpixel_bits
+ * fractional bits and the top-left fill rule is used
+ */
+block_rasterizer::block_rasterizer(int x1, int y1, int x2, int y2, int x3, int y3, int subpixel_bits,
+                                   int rect_x_min, int rect_y_min, int rect_x_max, int rect_y_max)
+    : valid(false)
+{
+    this->initialize_triangle(x1, y1, x2, y2, x3, y3, subpixel_bits, true, nullptr, 1, rect_x_min, rect_y_min, rect_x_max, rect_y_max);
+}
+
+/*
+ * Creates a block rasterizer with subpixel precision and several coverage samples per pixel, sample s of the pixel
+ * (x, y) is at the fixed-point position (x << subpixel_bits + sample_offsets[s][0], y << subpixel_bits + sample_offsets[s][1])
+ */
+block_rasterizer::block_rasterizer(int x1, int y1, int x2, int y2, int x3, int y3, int subpixel_bits,
+                                   const int sample_offsets[][2], int num_samples,
+                                   int rect_x_min, int rect_y_min, int rect_x_max, int rect_y_max)
+    : valid(false)
+{
+    if (num_samples < 1 || num_samples > max_samples) {
+        throw std::invalid_argument("block_rasterizer: the number of samples must be in [1, max_samples]");
+    }
+    this->initialize_triangle(x1, y1, x2, y2, x3, y3, subpixel_bits, true, sample_offsets, num_samples,
+                              rect_x_min, rect_y_min, rect_x_max, rect_y_max);
+}
+
+/*
+ * Returns the biggest integer <= a / b, for b > 0
+ */
+static std::int64_t floor_div(std::int64_t a, std::int64_t b)
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+/*
+ * Destroys the current instance of the block rasterizer
+ */
+block_rasterizer::~block_rasterizer()
+{}
+
+/*
+ * Sets up the edge functions and the first block, pixels outside of the rectangle are never covered
+ */
+void block_rasterizer::initialize_triangle(int x1, int y1, int x2, int y2, int x3, int y3, int subpixel_bits, bool top_left,
+                                           const int sample_offsets[][2], int num_samples,
+                                           int rect_x_min, int rect_y_min, int rect_x_max, int rect_y_max)
+{
+    // a single sample is at the position of the pixel
+    static const int no_offset[1][2] = {{0, 0}};
+    if (sample_offsets == nullptr) {
+        sample_offsets = no_offset;
+        num_samples = 1;
+    }
+    this->num_samples = num_samples;
+
+    // the edge functions are positive inside of a counterclockwise triangle, so the other winding is flipped
+    std::int64_t area = std::int64_t(x2 - x1) * (y3 - y1) - std::int64_t(y2 - y1) * (x3 - x1);
+    if (area == 0) {
+        return;
+    }
+    if (area < 0) {
+        std::swap(x2, x3);
+        std::swap(y2, y3);
+    }
+
+    const std::int64_t one = std::int64_t(1) << subpixel_bits;
+    int xs[3] = {x1, x2, x3};
+    int ys[3] = {y1, y2, y3};
+    for (int i = 0; i < 3; ++i) {
+        int j = (i + 1) % 3;
+        int dx = xs[j] - xs[i];
+        int dy = ys[j] - ys[i];
+
+        // E(X, Y) = (x_j - x_i) * (Y - y_i) - (y_j - y_i) * (X - x_i), at the fixed-point position of a pixel
+        // X = x * one and Y = y * one, so E(x, y) = one * (A * x + B * y) + c
+        A[i] = -dy;
+        B[i] = dx;
+        std::int64_t c = std::int64_t(dy) * xs[i] - std::int64_t(dx) * ys[i];
+
+        // fill convention: pixels exactly on an inclusive edge are inside, pixels on the other edges are outside
+        // (E >= 1 instead of E >= 0). both rules include left edges (going down), the triangle_rasterizer
+        // convention includes bottom edges (horizontal, going right) and the top-left rule top edges (going left)
+        bool inclusive = dy < 0 || (dy == 0 && (top_left ? dx < 0 : dx > 0));
+        if (!inclusive) {
+            c -= 1;
+        }
+
+        // A * x + B * y is an integer, so one * (A * x + B * y) + c >= 0 is the same as A * x + B * y + floor(c / one) >= 0.
+        // a sample offset by (ox, oy) from the pixel position adds A * ox + B * oy to c
+        for (int s = 0; s < num_samples; ++s) {
+            C[s][i] = floor_div(c + std::int64_t(A[i]) * sample_offsets[s][0] + std::int64_t(B[i]) * sample_offsets[s][1], one);
+        }
+    }
+
+    // bounding box of the pixels with a sample inside of the bounding box of the vertices
+    int min_ox = sample_offsets[0][0], max_ox = min_ox, min_oy = sample_offsets[0][1], max_oy = min_oy;
+    for (int s = 1; s < num_samples; ++s) {
+        min_ox = std::min(min_ox, sample_offsets[s][0]);
+        max_ox = std::max(max_ox, sample_offsets[s][0]);
+        min_oy = std::min(min_oy, sample_offsets[s][1]);
+        max_oy = std::max(max_oy, sample_offsets[s][1]);
+    }
+    std::int64_t min_x = std::min(std::min(x1, x2), x3), max_x = std::max(std::max(x1, x2), x3);
+    std::int64_t min_y = std::min(std::min(y1, y2), y3), max_y = std::max(std::max(y1, y2), y3);
+    this->x_min = (int) std::max<std::int64_t>(-floor_div(max_ox - min_x, one), rect_x_min);
+    this->y_min = (int) std::max<std::int64_t>(-floor_div(max_oy - min_y, one), rect_y_min);
+    this->x_max = (int) std::min<std::int64_t>(floor_div(max_x - min_ox, one), rect_x_max);
+    this->y_max = (int) std::min<std::int64_t>(floor_div(max_y - min_oy, one), rect_y_max);
+    if (this->x_min > this->x_max || this->y_min > this->y_max) {
+        return;
+    }
+
+    // blocks are aligned to the frame buffer, so that neighbouring triangles share the same blocks
+    this->x_current = this->x_min & ~(block_size - 1);
+    this->y_current = this->y_min & ~(block_size - 1);
+    this->valid = true;
+    if (!this->cover_block()) {
+        this->next_block();
+    }
+}
+
+/*
+ * Returns a vector which contains all the pixels inside the triangle
+ */
+std::vector<glm::ivec2> block_rasterizer::all_pixels()
+{
+    std::vector<glm::ivec2> points;
+
+    while (this->more_blocks()) {
+        std::uint64_t bits = this->mask;
+        while (bits) {
+            int bit = 0;
+            while (!((bits >> bit) & 1u)) {
+                ++bit;
+            }
+            points.push_back(glm::ivec2(x_current + (bit & 7), y_current + (bit >> 3)));
+            bits &= bits - 1;
+        }
+        this->next_block();
+    }
+
+    return points;
+}
+
+/*
+ * Checks if there are blocks covered by the triangle ready for use
+ * \return true if there are more blocks in the triangle, else false is returned
+ */
+bool block_rasterizer::more_blocks() const
+{
+    return this->valid;
+}
+
+/*
+ * Computes the next block with at least one pixel inside the triangle
+ */
+void block_rasterizer::next_block()
+{
+    while (this->valid) {
+        this->x_current += block_size;
+        if (this->x_current > this->x_max) {
+            this->x_current = this->x_min & ~(block_size - 1);
+            this->y_current += block_size;
+            if (this->y_current > this->y_max) {
+                this->valid = false;
+                return;
+            }
+        }
+        if (this->cover_block()) {
+            return;
+        }
+    }
+}
+
+/*
+ * Returns the x-coordinate of the lower left pixel of the current block
+ * It is only valid to call this function if "more_blocks()" returns true,
+ * else a "runtime_error" exception is thrown
+ */
+int block_rasterizer::x() const
+{
+    if (!this->valid) {
+        throw std::runtime_error("block_rasterizer::x(): Invalid State/Not Initialized");
+    }
+    return this->x_current;
+}
+
+/*
+ * Returns the y-coordinate of the lower left pixel of the current block
+ * It is only valid to call this function if "more_blocks()" returns true,
+ * else a "runtime_error" exception is thrown
+ */
+int block_rasterizer::y() const
+{
+    if (!this->valid) {
+        throw std::runtime_error("block_rasterizer::y(): Invalid State/Not Initialized");
+    }
+    return this->y_current;
+}
+
+/*
+ * Returns the coverage mask of the current block, bit (row * 8 + column) is set if the pixel
+ * (x() + column, y() + row) is inside the triangle
+ * It is only valid to call this function if "more_blocks()" returns true,
+ * else a "runtime_error" exception is thrown
+ */
+std::uint64_t block_rasterizer::coverage() const
+{
+    if (!this->valid) {
+        throw std::runtime_error("block_rasterizer::coverage(): Invalid State/Not Initialized");
+    }
+    return this->mask;
+}
+
+/*
+ * Returns the coverage mask of the sample s of the pixels of the current block, with the same bits as coverage()
+ */
+std::uint64_t block_rasterizer::sample_coverage(int s) const
+{
+    if (!this->valid) {
+        throw std::runtime_error("block_rasterizer::sample_coverage(): Invalid State/Not Initialized");
+    }
+    return this->sample_mask[s];
+}
+
+/*
+ * Returns true if all the pixels (and samples) of the current block are inside the triangle
+ */
+bool block_rasterizer::full() const
+{
+    return this->valid && this->is_full;
+}
+
+/*
+ * Returns the mask of the pixels of a block where the three edge functions E(c, r) = e0 + a * c + b * r are >= 0
+ */
+static std::uint64_t edge_mask(const int e0[3], const int a[3], const int b[3])
+{
+    const int block_size = block_rasterizer::block_size;
+    std::uint64_t bits = 0;
+    // a pixel is inside if no edge function is negative, i.e. if the sign bit of (E0 | E1 | E2) is not set
+#if defined(__AVX2__)
+    __m256i e[3], step[3];
+    for (int i = 0; i < 3; ++i) {
+        e[i] = _mm256_add_epi32(_mm256_set1_epi32(e0[i]),
+                                _mm256_mullo_epi32(_mm256_set1_epi32(a[i]), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+        step[i] = _mm256_set1_epi32(b[i]);
+    }
+    for (int r = 0; r < block_size; ++r) {
+        __m256i any = _mm256_or_si256(_mm256_or_si256(e[0], e[1]), e[2]);
+        std::uint64_t outside = (std::uint64_t) _mm256_movemask_ps(_mm256_castsi256_ps(any));
+        bits |= (~outside & 0xffu) << (r * block_size);
+        for (int i = 0; i < 3; ++i) {
+            e[i] = _mm256_add_epi32(e[i], step[i]);
+        }
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    // SSE2 has no 32 bit multiplication, the values of the 8 columns are set directly
+    __m128i lo[3], hi[3], step[3];
+    for (int i = 0; i < 3; ++i) {
+        lo[i] = _mm_setr_epi32(e0[i], e0[i] + a[i], e0[i] + 2 * a[i], e0[i] + 3 * a[i]);
+        hi[i] = _mm_add_epi32(lo[i], _mm_set1_epi32(4 * a[i]));
+        step[i] = _mm_set1_epi32(b[i]);
+    }
+    for (int r = 0; r < block_size; ++r) {
+        __m128i any_lo = _mm_or_si128(_mm_or_si128(lo[0], lo[1]), lo[2]);
+        __m128i any_hi = _mm_or_si128(_mm_or_si128(hi[0], hi[1]), hi[2]);
+        std::uint64_t outside = (std::uint64_t) (_mm_movemask_ps(_mm_castsi128_ps(any_lo)) |
+                                                 (_mm_movemask_ps(_mm_castsi128_ps(any_hi)) << 4));
+        bits |= (~outside & 0xffu) << (r * block_size);
+        for (int i = 0; i < 3; ++i) {
+            lo[i] = _mm_add_epi32(lo[i], step[i]);
+            hi[i] = _mm_add_epi32(hi[i], step[i]);
+        }
+    }
+#else
+    for (int r = 0; r < block_size; ++r) {
+        for (int c = 0; c < block_size; ++c) {
+            int any = (e0[0] + a[0] * c + b[0] * r) | (e0[1] + a[1] * c + b[1] * r) | (e0[2] + a[2] * c + b[2] * r);
+            if (any >= 0) {
+                bits |= std::uint64_t(1) << (r * block_size + c);
+            }
+        }
+    }
+#endif
+    return bits;
+}
+
+/*
+ * Computes the coverage of the block at the current position, returns false if it is empty
+ */
+bool block_rasterizer::cover_block()
+{
+    const int last = block_size - 1;
+    int x0 = this->x_current;
+    int y0 = this->y_current;
+
+    // pixels of the block outside of the frame buffer (or of the bounding box) are never covered
+    std::uint64_t row_bits = 0xffu;
+    if (x0 < this->x_min) {
+        row_bits &= 0xffu << (this->x_min - x0);
+    }
+    if (x0 + last > this->x_max) {
+        row_bits &= 0xffu >> (x0 + last - this->x_max);
+    }
+    std::uint64_t inside = 0;
+    for (int r = std::max(this->y_min - y0, 0), r_end = std::min(this->y_max - y0, last); r <= r_end; ++r) {
+        inside |= row_bits << (r * block_size);
+    }
+
+    this->mask = 0;
+    this->is_full = true;
+    for (int s = 0; s < this->num_samples; ++s) {
+        // the edge functions are linear, so their smallest and biggest values in the block are at its corners
+        int e0[3], a[3], b[3];
+        bool accept = true, reject = false;
+        for (int i = 0; i < 3 && !reject; ++i) {
+            std::int64_t e = std::int64_t(A[i]) * x0 + std::int64_t(B[i]) * y0 + C[s][i];
+            std::int64_t e_max = e + std::max<std::int64_t>(std::int64_t(A[i]) * last, 0) + std::max<std::int64_t>(std::int64_t(B[i]) * last, 0);
+            std::int64_t e_min = e + std::min<std::int64_t>(std::int64_t(A[i]) * last, 0) + std::min<std::int64_t>(std::int64_t(B[i]) * last, 0);
+            if (e_max < 0) {
+                reject = true;
+            }
+            else if (e_min >= 0) {
+                // the whole block is inside of this edge, it is left out of the per pixel test
+                e0[i] = a[i] = b[i] = 0;
+            }
+            else {
+                // the edge crosses the block, so its values in the block are small enough for 32 bits
+                e0[i] = (int) e;
+                a[i] = A[i];
+                b[i] = B[i];
+                accept = false;
+            }
+        }
+
+        std::uint64_t bits = 0;
+        if (!reject) {
+            bits = accept ? inside : edge_mask(e0, a, b) & inside;
+        }
+        this->sample_mask[s] = bits;
+        this->mask |= bits;
+        this->is_full = this->is_full && bits == ~std::uint64_t(0);
+    }
+
+    return this->mask != 0;
+}
@@ -0,0 +1,205 @@
+#ifndef __BLOCK_H__
+#define __BLOCK_H__
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+/**
+ * \class block_rasterizer
+ * A class which scanconverts a triangle by evaluating its three edge functions (half-spaces) over blocks of
+ * 8x8 pixels. Blocks completely outside of the triangle are rejected and blocks completely inside are accepted
+ * with a single test, the coverage of the other blocks is computed for 8 pixels at a time with SIMD instructions.
+ * With whole pixel vertices it covers the same pixels as the triangle_rasterizer: pixels on the left and bottom
+ * edges of the triangle are inside, pixels on the right and top edges are outside.
+ * With subpixel (fixed-point) vertices it samples the centers of the pixels with the top-left fill rule. The edge
+ * functions are exact integers in both cases, so a pixel on an edge shared by two triangles is covered by only one.
+ */
+class block_rasterizer {
+public:
+    /**
+     * The width and height of a block in pixels
+     */
+    static const int block_size = 8;
+
+    /**
+     * The number of fractional bits of the fixed-point vertices used for subpixel precision
+     */
+    static const int subpixel_bits = 8;
+
+    /**
+     * The maximum number of coverage samples per pixel
+     */
+    static const int max_samples = 4;
+
+    /**
+     * Parameterized constructor creates an instance of a block rasterizer
+     * \param x1 - the x-coordinate of the first vertex
+     * \param y1 - the y-coordinate of the first vertex
+     * \param x2 - the x-coordinate of the second vertex
+     * \param y2 - the y-coordinate of the second vertex
+     * \param x3 - the x-coordinate of the third vertex
+     * \param y3 - the y-coordinate of the third vertex
+     * \param width - the width of the frame buffer, pixels outside of [0, width) are never covered
+     * \param height - the height of the frame buffer, pixels outside of [0, height) are never covered
+     */
+    block_rasterizer(int x1, int y1, int x2, int y2, int x3, int y3, int width, int height);
+
+    /**
+     * Parameterized constructor creates an instance of a block rasterizer which only covers the pixels inside
+     * of a rectangle (e.g. a tile of the frame buffer), x_min and y_min should be multiples of the block size
+     * \param x1 - the x-coordinate of the first vertex
+     * \param y1 - the y-coordinate of the first vertex
+     * \param x2 - the x-coordinate of the second vertex
+     * \param y2 - the y-coordinate of the second vertex
+     * \param x3 - the x-coordinate of the third vertex
+     * \param y3 - the y-coordinate of the third vertex
+     * \param rect_x_min - the x-coordinate of the first column of the rectangle
+     * \param rect_y_min - the y-coordinate of the first row of the rectangle
+     * \param rect_x_max - the x-coordinate of the last column of the rectangle
+     * \param rect_y_max - the y-coordinate of the last row of the rectangle
+     */
+    block_rasterizer(int x1, int y1, int x2, int y2, int x3, int y3,
+                     int rect_x_min, int rect_y_min, int rect_x_max, int rect_y_max);
+
+    /**
+     * Parameterized constructor creates an instance of a block rasterizer with subpixel precision, the vertices are
+     * in fixed point with subpixel_bits fractional bits (e.g. x * 256 rounded to the closest integer), and the pixel
+     * (x, y) is covered if the point (x << subpixel_bits, y << subpixel_bits) is inside of the triangle.
+     * Points exactly on a top edge (horizontal, above the triangle) or on a left edge are inside
+     * \param x1 - the fixed-point x-coordinate of the first vertex
+     * \param y1 - the fixed-point y-coordinate of the first vertex
+     * \param x2 - the fixed-point x-coordinate of the second vertex
+     * \param y2 - the fixed-point y-coordinate of the second vertex
+     * \param x3 - the fixed-point x-coordinate of the third vertex
+     * \param y3 - the fixed-point y-coordinate of the third vertex
+     * \param subpixel_bits - the number of fractional bits of the vertex coordinates
+     * \param rect_x_min - the x-coordinate of the first column of the rectangle, in pixels
+     * \param rect_y_min - the y-coordinate of the first row of the rectangle, in pixels
+     * \param rect_x_max - the x-coordinate of the last column of the rectangle, in pixels
+     * \param rect_y_max - the y-coordinate of the last row of the rectangle, in pixels
+     */
+    block_rasterizer(int x1, int y1, int x2, int y2, int x3, int y3, int subpixel_bits,
+                     int rect_x_min, int rect_y_min, int rect_x_max, int rect_y_max);
+
+    /**
+     * Parameterized constructor creates an instance of a block rasterizer with subpixel precision and several
+     * coverage samples per pixel (e.g. for multisample anti-aliasing), with the top-left fill rule.
+     * Sample s of the pixel (x, y) is at the fixed-point position
+     * ((x << subpixel_bits) + sample_offsets[s][0], (y << subpixel_bits) + sample_offsets[s][1])
+     * \param x1 - the fixed-point x-coordinate of the first vertex
+     * \param y1 - the fixed-point y-coordinate of the first vertex
+     * \param x2 - the fixed-point x-coordinate of the second vertex
+     * \param y2 - the fixed-point y-coordinate of the second vertex
+     * \param x3 - the fixed-point x-coordinate of the third vertex
+     * \param y3 - the fixed-point y-coordinate of the third vertex
+     * \param subpixel_bits - the number of fractional bits of the vertex coordinates and sample offsets
+     * \param sample_offsets - the fixed-point offsets of the samples from the pixel position
+     * \param num_samples - the number of samples, at most max_samples
+     * \param rect_x_min - the x-coordinate of the first column of the rectangle, in pixels
+     * \param rect_y_min - the y-coordinate of the first row of the rectangle, in pixels
+     * \param rect_x_max - the x-coordinate of the last column of the rectangle, in pixels
+     * \param rect_y_max - the y-coordinate of the last row of the rectangle, in pixels
+     */
+    block_rasterizer(int x1, int y1, int x2, int y2, int x3, int y3, int subpixel_bits,
+                     const int sample_offsets[][2], int num_samples,
+                     int rect_x_min, int rect_y_min, int rect_x_max, int rect_y_max);
+
+    /**
+     * Destroys the current instance of the block rasterizer
+     */
+    virtual ~block_rasterizer();
+
+    /**
+     * Returns a vector which contains all the pixels inside the triangle
+     */
+    std::vector<glm::ivec2> all_pixels();
+
+    /**
+     * Checks if there are blocks covered by the triangle ready for use
+     * \return true if there are more blocks in the triangle, else false is returned
+     */
+    bool more_blocks() const;
+
+    /**
+     * Computes the next block with at least one pixel inside the triangle
+     */
+    void next_block();
+
+    /**
+     * Returns the x-coordinate of the lower left pixel of the current block
+     * It is only valid to call this function if "more_blocks()" returns true,
+     * else a "runtime_error" exception is thrown
+     */
+    int x() const;
+
+    /**
+     * Returns the y-coordinate of the lower left pixel of the current block
+     * It is only valid to call this function if "more_blocks()" returns true,
+     * else a "runtime_error" exception is thrown
+     */
+    int y() const;
+
+    /**
+     * Returns the coverage mask of the current block, bit (row * 8 + column) is set if the pixel
+     * (x() + column, y() + row) is inside the triangle (if any of its samples is, with several samples)
+     * It is only valid to call this function if "more_blocks()" returns true,
+     * else a "runtime_error" exception is thrown
+     */
+    std::uint64_t coverage() const;
+
+    /**
+     * Returns the coverage mask of the sample s of the pixels of the current block, with the same bits as coverage()
+     * It is only valid to call this function if "more_blocks()" returns true,
+     * else a "runtime_error" exception is thrown
+     */
+    std::uint64_t sample_coverage(int s) const;
+
+    /**
+     * Returns true if all the pixels (and samples) of the current block are inside the triangle
+     */
+    bool full() const;
+
+private:
+    /**
+     * Computes the coverage of the block at the current position, returns false if it is empty
+     */
+    bool cover_block();
+
+    /**
+     * Sets up the edge functions and the first block, pixels outside of the rectangle are never covered
+     */
+    void initialize_triangle(int x1, int y1, int x2, int y2, int x3, int y3, int subpixel_bits, bool top_left,
+                             const int sample_offsets[][2], int num_samples,
+                             int rect_x_min, int rect_y_min, int rect_x_max, int rect_y_max);
+
+    /**
+     * The coefficients of the three edge functions E(x, y) = A * x + B * y + C in pixel coordinates,
+     * a pixel is inside the triangle if the three functions are >= 0 at its position.
+     * C is 64 bits since it grows with the square of the (fixed-point) coordinates, and there is one per sample
+     */
+    int A[3];
+    int B[3];
+    std::int64_t C[max_samples][3];
+    int num_samples;
+
+    // Bounding box of the triangle in pixels, clamped to the frame buffer (or rectangle)
+    int x_min;
+    int y_min;
+    int x_max;
+    int y_max;
+
+    // Lower left pixel of the current block
+    int x_current;
+    int y_current;
+
+    // Coverage of the current block, of all samples and of each sample
+    std::uint64_t mask;
+    std::uint64_t sample_mask[max_samples];
+    bool is_full;
+
+    bool valid;
+};
+
+#endif
@@ -1,10 +1,29 @@
 #include "trianglerasterizer.h"
 
+#include <algorithm>
+#include <limits>
+
 /*
  * \class triangle_rasterizer
  * A class which scanconverts a triangle. It computes the pixels such that they are inside the triangle.
  */
-triangle_rasterizer::triangle_rasterizer(int x1, int y1, int x2, int y2, int x3, int y3) : valid(false)
+triangle_rasterizer::triangle_rasterizer(int x1, int y1, int x2, int y2, int x3, int y3)
+    : scissor_x_min(std::numeric_limits<int>::min()), scissor_y_min(std::numeric_limits<int>::min()),
+      scissor_x_max(std::numeric_limits<int>::max()), scissor_y_max(std::numeric_limits<int>::max()),
+      valid(false)
+{
+    this->initialize_triangle(x1, y1, x2, y2, x3, y3);
+}
+
+/*
+ * Creates a triangle rasterizer which only computes the pixels inside of the scissor rectangle
+ * [scissor_x_min, scissor_x_max] x [scissor_y_min, scissor_y_max]
+ */
+triangle_rasterizer::triangle_rasterizer(int x1, int y1, int x2, int y2, int x3, int y3,
+                                         int scissor_x_min, int scissor_y_min, int scissor_x_max, int scissor_y_max)
+    : scissor_x_min(scissor_x_min), scissor_y_min(scissor_y_min),
+      scissor_x_max(scissor_x_max), scissor_y_max(scissor_y_max),
+      valid(false)
 {
     this->initialize_triangle(x1, y1, x2, y2, x3, y3);
 }
@@ -52,18 +71,33 @@ void triangle_rasterizer::next_fragment()
     else {
         this->leftedge.next_fragment();
         this->rightedge.next_fragment();
-        while (this->leftedge.more_fragments() && (leftedge.x() >= rightedge.x())) {
-            leftedge.next_fragment();
-            rightedge.next_fragment();
+        this->find_span();
+    }
+}
+
+/*
+ * Moves the edges to the first row, starting at the current one, with pixels inside the triangle
+ * and the scissor rectangle, and sets the current fragment to its first pixel
+ */
+void triangle_rasterizer::find_span()
+{
+    while (this->leftedge.more_fragments()) {
+        // the rows go up, so there is nothing left once we are above the scissor rectangle
+        if (leftedge.y() > this->scissor_y_max) {
+            break;
         }
-        this->valid = this->leftedge.more_fragments();
-        if (this->valid) {
-            this->x_start   = leftedge.x();
+        this->x_start = std::max(leftedge.x(), this->scissor_x_min);
+        this->x_stop  = std::min(rightedge.x() - 1, this->scissor_x_max);
+        if (leftedge.y() >= this->scissor_y_min && this->x_start <= this->x_stop) {
             this->x_current = this->x_start;
-            this->x_stop    = rightedge.x() - 1;
             this->y_current = leftedge.y();
+            this->valid = true;
+            return;
         }
+        leftedge.next_fragment();
+        rightedge.next_fragment();
     }
+    this->valid = false;
 }
 
 /*
@@ -150,19 +184,10 @@ void triangle_rasterizer::initialize_triangle(int x1, int y1, int x2, int y2, in
         // Now the leftedge and rightedge `edge_rasterizers' are initialized, so they are
         // ready for use.
 
-        this->x_start   = this->leftedge.x();
         this->y_start   = this->leftedge.y();
-
-        this->x_current = this->x_start;
-        this->y_current = this->y_start;
-
-        this->x_stop    = this->rightedge.x() - 1;
         this->y_stop    = this->ivertex[this->upper_left].y;
 
-        this->valid = (this->x_current <= this->x_stop);
-        if (!(this->valid)) {
-            this->next_fragment();
-        }
+        this->find_span();
     }
 }
 
@@ -30,6 +30,23 @@ public:
      */
     triangle_rasterizer(int x1, int y1, int x2, int y2, int x3, int y3);
 
+    /**
+     * Parameterized constructor creates an instance of a triangle rasterizer which only computes the pixels
+     * inside of a scissor rectangle (e.g. the frame buffer), the rows and columns outside of it are skipped
+     * \param x1 - the x-coordinate of the first vertex
+     * \param y1 - the y-coordinate of the first vertex
+     * \param x2 - the x-coordinate of the second vertex
+     * \param y2 - the y-coordinate of the second vertex
+     * \param x3 - the x-coordinate of the third vertex
+     * \param y3 - the y-coordinate of the third vertex
+     * \param scissor_x_min - the x-coordinate of the first column of the scissor rectangle
+     * \param scissor_y_min - the y-coordinate of the first row of the scissor rectangle
+     * \param scissor_x_max - the x-coordinate of the last column of the scissor rectangle
+     * \param scissor_y_max - the y-coordinate of the last row of the scissor rectangle
+     */
+    triangle_rasterizer(int x1, int y1, int x2, int y2, int x3, int y3,
+                        int scissor_x_min, int scissor_y_min, int scissor_x_max, int scissor_y_max);
+
     /**
      * Destroys the current instance of the triangle rasterizer
      */
@@ -81,6 +98,12 @@ private:
      */
     void initialize_triangle(int x1, int y1, int x2, int y2, int x3, int y3);
 
+    /**
+     * Moves the edges to the first row, starting at the current one, with pixels inside the triangle
+     * and the scissor rectangle, and sets the current fragment to its first pixel
+     */
+    void find_span();
+
 
     /**
      * Computes the index of the lower left vertex in the array ivertex
@@ -124,6 +147,12 @@ private:
     int       x_current;
     int       y_current;
 
+    // Scissor rectangle, pixels outside of it are never computed
+    int       scissor_x_min;
+    int       scissor_y_min;
+    int       scissor_x_max;
+    int       scissor_y_max;
+
     bool valid;
 };
 
@@ -0,0 +1,200 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_SRL_BINNING_RENDERER_H
+#define ITU_GRAPHICS_PROGRAMMING_SRL_BINNING_RENDERER_H
+
+#include <algorithm>
+#include "srl_triangle_renderer.h"
+#include "srl_thread_pool.h"
+
+namespace srl {
+
+    // multithreaded (sort-middle) version of the triangle renderer, it renders the same images in three steps:
+    // 1. geometry: the triangles are split in contiguous ranges, and each range goes through the vertex processing,
+    //    clipping, perspective division, screen space transformation and backface culling in any free thread
+    // 2. binning: each range adds its screen space triangles to the bins of the tiles of the frame buffer that
+    //    their bounding box overlaps
+    // 3. rasterization: each tile is rasterized (with the block rasterizer) and depth tested by a single thread, which
+    //    owns that region of the frame buffers. it goes over the bins of the ranges in order, so that the triangles of
+    //    a tile are drawn in the same order as in the vertex list
+    // the vertices and fragments are shaded with Shader, as in ShadedTriangleRenderer
+    template <typename Shader>
+    class ShadedBinningRenderer : public ShadedTriangleRenderer<Shader> {
+        typedef ShadedTriangleRenderer<Shader> Base;
+
+    public:
+        using Base::m_hierarchicalZ;
+        using Base::m_guardBandClipping;
+        using Base::m_guardBand;
+        using Base::m_subpixelPrecision;
+        using Base::m_multisample;
+        using Base::m_colorEncoding;
+        using Base::m_numThreads;
+        using Base::shader;
+
+        explicit ShadedBinningRenderer(const Shader &shader = Shader()) : Base(shader) {}
+
+        // width and height of the tiles in pixels, rounded up to a multiple of the block size of the block rasterizer
+        int m_tileSize = 32;
+
+        void render(const std::vector<vertex> &vts,
+                    const glm::mat4 &m,
+                    const glm::mat4 &vp,
+                    CustomFrameBuffer <uint32_t> &fb,
+                    CustomFrameBuffer <float> &db) override {
+            renderParallel(vts, nullptr, vts.size() / 3, vp * m, fb, db);
+        }
+
+        void render(const std::vector<vertex> &vts,
+                    const std::vector<unsigned int> &indices,
+                    const glm::mat4 &m,
+                    const glm::mat4 &vp,
+                    CustomFrameBuffer <uint32_t> &fb,
+                    CustomFrameBuffer <float> &db) override {
+            renderParallel(vts, indices.data(), indices.size() / 3, vp * m, fb, db);
+        }
+
+    private:
+        typedef typename Base::VertexCache VertexCache;
+        using Base::m_vertexCache;
+        using Base::m_hiZ;
+        using Base::m_shader;
+
+        // renders numTriangles triangles, with the vertices of triangle t at indices[3t], indices[3t+1] and
+        // indices[3t+2] of vts (or 3t, 3t+1 and 3t+2 if indices is null)
+        void renderParallel(const std::vector<vertex> &vts, const unsigned int *indices, size_t numTriangles,
+                            const glm::mat4 &modelViewProjection, CustomFrameBuffer <uint32_t> &fb,
+                            CustomFrameBuffer <float> &db) {
+            ThreadPool &pool = this->threadPool();
+            unsigned int numThreads = pool.size();
+
+            const int blockSize = block_rasterizer::block_size;
+            int tileSize = std::max(blockSize, (m_tileSize + blockSize - 1) / blockSize * blockSize);
+            int tilesX = ((int) fb.W + tileSize - 1) / tileSize;
+            int tilesY = ((int) fb.H + tileSize - 1) / tileSize;
+
+            // a few ranges per thread, so that the threads with cheap ranges (e.g. all culled) take more of them
+            unsigned int numRanges = (unsigned int) std::max<size_t>(1, std::min<size_t>(numThreads * 4, numTriangles));
+
+            // each vertex is processed once, by the thread of the range of the vertex list that contains it
+            m_vertexCache.clip.resize(vts.size());
+            m_vertexCache.divided.resize(vts.size());
+            m_vertexCache.outcodes.resize(vts.size());
+            pool.parallelFor(numRanges, [&](unsigned int r){
+                this->processVertices(modelViewProjection, vts, m_vertexCache, vts.size() * r / numRanges, vts.size() * (r + 1) / numRanges);
+            });
+
+            m_ranges.resize(numRanges);
+            pool.parallelFor(numRanges, [&](unsigned int r){
+                m_ranges[r].m_guardBandClipping = m_guardBandClipping;
+                m_ranges[r].m_guardBand = m_guardBand;
+                m_ranges[r].processGeometry(m_vertexCache, indices, numTriangles * r / numRanges,
+                                            numTriangles * (r + 1) / numRanges, fb.W, fb.H);
+                m_ranges[r].binPrimitives(tileSize, tilesX, tilesY);
+            });
+
+            // the tiles of the hierarchical z buffer are the same as the tiles of the threads, so that each thread only
+            // updates the part of it that covers its tile
+            if (m_hierarchicalZ && !m_multisample)
+                m_hiZ.build(db, tileSize);
+
+            // the samples of a pixel are in the same tile as the pixel, so multisampling doesn't change the ownership
+            pool.parallelFor((unsigned int) (tilesX * tilesY), [&](unsigned int t){
+                int x0 = (int) (t % tilesX) * tileSize;
+                int y0 = (int) (t / tilesX) * tileSize;
+                int x1 = std::min(x0 + tileSize, (int) fb.W) - 1;
+                int y1 = std::min(y0 + tileSize, (int) fb.H) - 1;
+
+                for (auto &range : m_ranges) {
+                    for (unsigned int i : range.m_bins[t]) {
+                        const triangle &tri = range.primitives()[i];
+                        if (m_multisample) {
+                            Base::rasterTriangleMSAA(tri, x0, y0, x1, y1, m_shader, m_colorEncoding, *m_multisample);
+                            continue;
+                        }
+                        if (m_hierarchicalZ) {
+                            Base::rasterTriangleHiZ(tri, x0, y0, x1, y1, m_subpixelPrecision, m_shader, m_colorEncoding, fb, db, m_hiZ);
+                            continue;
+                        }
+
+                        block_rasterizer rasterizer = Base::blockRasterizer(tri, m_subpixelPrecision, x0, y0, x1, y1);
+                        Base::visitBlocks(rasterizer, tri, [&](const glm::ivec2 &pxl, const vertex &interp){
+                            float depth;
+                            Base::shadePixel(tri, pxl, interp, m_shader, m_colorEncoding, fb, db, depth);
+                        });
+                    }
+                }
+            });
+        }
+
+        // a range of triangles of the vertex list, with its own primitive list. it only runs the geometry stages,
+        // which don't depend on the shader, and the triangle setup of the attributes in Shader::varyings
+        class Range : public TriangleRenderer {
+        public:
+            // geometry stages of the pipeline for the triangles [first, last), leaves the triangles in window
+            // coordinates in m_primitives. the vertices were already processed in the shared vertex cache
+            void processGeometry(const VertexCache &cache, const unsigned int *indices, size_t first, size_t last,
+                                 int width, int height) {
+                m_sharedCache = &cache;
+                m_primitives.clear();
+                assembleTriangles(cache.clip, indices, first, last);
+                clipPrimitives();
+                divideByW();
+                toScreenSpace(width, height);
+                backfaceCulling();
+                setupPrimitives();
+            }
+
+            // adds the index of each visible triangle to the bins of the tiles its bounding box overlaps
+            void binPrimitives(int tileSize, int tilesX, int tilesY) {
+                m_bins.resize(tilesX * tilesY);
+                for (auto &bin : m_bins)
+                    bin.clear();
+
+                for (unsigned int i = 0; i < m_primitives.size(); i++) {
+                    const triangle &tri = m_primitives[i];
+                    if (tri.rejected)
+                        continue;
+
+                    glm::ivec2 iv1 = pixelAt(tri.v1.pos);
+                    glm::ivec2 iv2 = pixelAt(tri.v2.pos);
+                    glm::ivec2 iv3 = pixelAt(tri.v3.pos);
+                    glm::ivec2 minPxl = glm::min(glm::min(iv1, iv2), iv3);
+                    glm::ivec2 maxPxl = glm::max(glm::max(iv1, iv2), iv3);
+                    if (maxPxl.x < 0 || maxPxl.y < 0)
+                        continue;
+
+                    int tx0 = std::max(minPxl.x, 0) / tileSize, tx1 = std::min(maxPxl.x / tileSize, tilesX - 1);
+                    int ty0 = std::max(minPxl.y, 0) / tileSize, ty1 = std::min(maxPxl.y / tileSize, tilesY - 1);
+                    for (int ty = ty0; ty <= ty1; ty++)
+                        for (int tx = tx0; tx <= tx1; tx++)
+                            m_bins[ty * tilesX + tx].push_back(i);
+                }
+            }
+
+            const std::vector<triangle> &primitives() const { return m_primitives; }
+
+            // indices (in m_primitives) of the triangles overlapping each tile
+            std::vector<std::vector<unsigned int>> m_bins;
+
+        private:
+            const VertexCache &vertexCache() const override { return *m_sharedCache; }
+
+            // the gradients of the attributes the fragments of Shader get, as in ShadedTriangleRenderer<Shader>
+            void setupPrimitives() override {
+                typedef typename Shader::varyings varyings;
+                for (auto &tri : m_primitives) {
+                    if (!tri.rejected)
+                        tri.template setup<varyings::color, varyings::normal, varyings::uv>();
+                }
+            }
+
+            const VertexCache *m_sharedCache = nullptr;
+        };
+
+        std::vector<Range> m_ranges;
+    };
+
+    typedef ShadedBinningRenderer<DefaultShader> BinningRenderer;
+
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_SRL_BINNING_RENDERER_H
@@ -0,0 +1,18 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_SRL_COLOR_H
+#define ITU_GRAPHICS_PROGRAMMING_SRL_COLOR_H
+
+#include <swr/color.h>
+#include "srl_types.h"
+
+namespace srl {
+    namespace Colors {
+        // the encodings and conversions to RGBA8 are shared with the ray tracer of exercise 10
+        using swr::Encoding;
+        using swr::ditherThreshold;
+        using swr::linearToSRGB;
+        using swr::sRGBToLinear;
+        using swr::toRGBA32;
+    }
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_SRL_COLOR_H
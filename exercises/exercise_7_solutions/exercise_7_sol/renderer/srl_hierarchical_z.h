@@ -0,0 +1,107 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_SRL_HIERARCHICAL_Z_H
+#define ITU_GRAPHICS_PROGRAMMING_SRL_HIERARCHICAL_Z_H
+
+#include <vector>
+#include <algorithm>
+#include "srl_types.h"
+
+namespace srl {
+
+    // coarse version of a depth buffer, used to reject triangles and blocks of pixels that are behind what was already
+    // drawn without rasterizing or interpolating them. it has two levels: the biggest depth of each block of 8x8 pixels
+    // (the blocks of the block rasterizer), and the biggest depth of each tile of blocks.
+    // only the biggest depths are kept, since a fragment passes the depth test if it is closer than the stored depth:
+    // something farther than all the depths of a block can't be visible in it
+    class HierarchicalZ {
+    public:
+        static const int block_size = 8;
+
+        // rebuilds both levels from the depth buffer, e.g. after it was cleared.
+        // tileSize is the width and height of the tiles of the second level, a multiple of block_size
+        void build(CustomFrameBuffer<float> &db, int tileSize) {
+            m_W = (int) db.W;
+            m_H = (int) db.H;
+            m_blocksX = (m_W + block_size - 1) / block_size;
+            m_blocksY = (m_H + block_size - 1) / block_size;
+            m_tileBlocks = std::max(1, tileSize / block_size);
+            m_tilesX = (m_blocksX + m_tileBlocks - 1) / m_tileBlocks;
+            m_tilesY = (m_blocksY + m_tileBlocks - 1) / m_tileBlocks;
+            m_max.resize(m_blocksX * m_blocksY);
+            m_tileMax.resize(m_tilesX * m_tilesY);
+
+            for (int by = 0; by < m_blocksY; by++)
+                for (int bx = 0; bx < m_blocksX; bx++)
+                    readBlock(db, bx, by);
+            for (int ty = 0; ty < m_tilesY; ty++)
+                for (int tx = 0; tx < m_tilesX; tx++)
+                    updateTile(tx, ty);
+        }
+
+        // true if nothing at depth zMin or farther can pass the depth test in the block (bx, by)
+        bool blockOccluded(int bx, int by, float zMin) const {
+            return zMin > m_max[by * m_blocksX + bx];
+        }
+
+        // true if nothing at depth zMin or farther can pass the depth test in the pixel rectangle [x0, x1] x [y0, y1]
+        bool rectOccluded(int x0, int y0, int x1, int y1, float zMin) const {
+            x0 = std::max(x0, 0); y0 = std::max(y0, 0);
+            x1 = std::min(x1, m_W - 1); y1 = std::min(y1, m_H - 1);
+            if (x0 > x1 || y0 > y1)
+                return true;
+
+            int tileSize = m_tileBlocks * block_size;
+            for (int ty = y0 / tileSize; ty <= y1 / tileSize; ty++)
+                for (int tx = x0 / tileSize; tx <= x1 / tileSize; tx++)
+                    if (!(zMin > m_tileMax[ty * m_tilesX + tx]))
+                        return false;
+            return true;
+        }
+
+        // the depth buffer changed inside the block (bx, by), reads its new depths
+        void blockChanged(CustomFrameBuffer<float> &db, int bx, int by) {
+            readBlock(db, bx, by);
+            updateTile(bx / m_tileBlocks, by / m_tileBlocks);
+        }
+
+        // all the pixels of the block (bx, by) were written, and zMax is the biggest of the new depths.
+        // the new bound is known without reading the depth buffer
+        void blockOverwritten(int bx, int by, float zMax) {
+            m_max[by * m_blocksX + bx] = zMax;
+            updateTile(bx / m_tileBlocks, by / m_tileBlocks);
+        }
+
+    private:
+        void readBlock(CustomFrameBuffer<float> &db, int bx, int by) {
+            int x0 = bx * block_size, x1 = std::min(x0 + block_size, m_W);
+            int y0 = by * block_size, y1 = std::min(y0 + block_size, m_H);
+            // the blocks are the tiles of the fast clear, a cleared block is not in the buffer yet
+            if (db.isCleared(x0, y0)) {
+                m_max[by * m_blocksX + bx] = db.lastClearValue();
+                return;
+            }
+            float zMax = db.buffer[y0 * m_W + x0];
+            for (int y = y0; y < y1; y++)
+                for (int x = x0; x < x1; x++)
+                    zMax = std::max(zMax, db.buffer[y * m_W + x]);
+            m_max[by * m_blocksX + bx] = zMax;
+        }
+
+        void updateTile(int tx, int ty) {
+            int bx0 = tx * m_tileBlocks, bx1 = std::min(bx0 + m_tileBlocks, m_blocksX);
+            int by0 = ty * m_tileBlocks, by1 = std::min(by0 + m_tileBlocks, m_blocksY);
+            float zMax = m_max[by0 * m_blocksX + bx0];
+            for (int by = by0; by < by1; by++)
+                for (int bx = bx0; bx < bx1; bx++)
+                    zMax = std::max(zMax, m_max[by * m_blocksX + bx]);
+            m_tileMax[ty * m_tilesX + tx] = zMax;
+        }
+
+        int m_W = 0, m_H = 0;
+        int m_blocksX = 0, m_blocksY = 0;
+        int m_tileBlocks = 1, m_tilesX = 0, m_tilesY = 0;
+        std::vector<float> m_max;
+        std::vector<float> m_tileMax;
+    };
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_SRL_HIERARCHICAL_Z_H
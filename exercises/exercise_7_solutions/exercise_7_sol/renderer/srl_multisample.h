@@ -0,0 +1,106 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_SRL_MULTISAMPLE_H
+#define ITU_GRAPHICS_PROGRAMMING_SRL_MULTISAMPLE_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include "srl_types.h"
+#include "srl_color.h"
+#include "rasterizer/blockrasterizer.h"
+
+namespace srl {
+
+    // color and depth buffers with 4 samples per pixel, for multisample anti-aliasing (MSAA).
+    // the triangle renderers test the coverage and the depth of each sample, but shade each pixel only once per
+    // triangle, so the edges are smoother at almost the cost of rendering without it.
+    // the samples of a pixel are next to each other in memory: sample s of the pixel (x, y) is at
+    // (y * W + x) * samples + s. after rendering, resolve() averages them into a normal frame buffer
+    class MultisampleBuffer {
+    public:
+        static const int samples = 4;
+        typedef const int (*Offsets)[2];
+
+        unsigned int W, H;
+        CustomFrameBuffer<std::uint32_t> color;
+        CustomFrameBuffer<float> depth;
+
+        MultisampleBuffer(unsigned int width, unsigned int height)
+                : W(width), H(height), color(width * samples, height), depth(width * samples, height) {}
+
+        // offsets of the samples from the position of the pixel, in fixed point with block_rasterizer::subpixel_bits
+        // fractional bits. it is the rotated grid of 4x MSAA in Direct3D (in 1/16 of a pixel: (-2, -6), (6, -2),
+        // (-6, 2) and (2, 6)), so that near horizontal and near vertical edges cross the 4 samples at different steps
+        static Offsets sampleOffsets() {
+            static const int unit = (1 << block_rasterizer::subpixel_bits) / 16;
+            static const int offsets[samples][2] = {{-2 * unit, -6 * unit}, {6 * unit, -2 * unit},
+                                                    {-6 * unit, 2 * unit}, {2 * unit, 6 * unit}};
+            return offsets;
+        }
+
+        // offset of the sample s from the position of the pixel, in pixels
+        static glm::vec2 sampleOffset(int s) {
+            const float one = float(1 << block_rasterizer::subpixel_bits);
+            return glm::vec2(sampleOffsets()[s][0] / one, sampleOffsets()[s][1] / one);
+        }
+
+        // the samples are accessed directly in the buffers, so they are filled now instead of with a fast clear
+        void clear(std::uint32_t colorValue, float depthValue) {
+            color.fillBuffer(colorValue);
+            depth.fillBuffer(depthValue);
+        }
+
+        std::uint32_t &colorAt(int x, int y, int s) { return color.buffer[(y * W + x) * samples + s]; }
+        float &depthAt(int x, int y, int s) { return depth.buffer[(y * W + x) * samples + s]; }
+
+        // writes the average color of the samples of each pixel to fb, which must have the same size. encoding is the
+        // one the samples were written with (Renderer::m_colorEncoding): with sRGB the samples are decoded to linear,
+        // averaged and encoded again, since the average of the encoded values is too dark at the edges. the dither
+        // of the samples is kept, it isn't added again
+        void resolve(CustomFrameBuffer<std::uint32_t> &fb, const Colors::Encoding &encoding = Colors::Encoding()) const {
+            assert (fb.W == W && fb.H == H);
+            fb.prepareWrite(0, 0, W - 1, H - 1, true);
+            const std::uint32_t *in = color.buffer;
+            if (!encoding.srgb) {
+                for (unsigned int i = 0; i < W * H; i++, in += samples) {
+                    std::uint32_t out = 0;
+                    for (int shift = 0; shift < 32; shift += 8)
+                        out |= averageChannel(in, shift) << shift;
+                    fb.buffer[i] = out;
+                }
+                return;
+            }
+
+            // linear value of each 8 bits sRGB value
+            static const std::vector<float> toLinear = [](){
+                std::vector<float> table(256);
+                for (int v = 0; v < 256; v++)
+                    table[v] = Colors::sRGBToLinear(v / 255.f);
+                return table;
+            }();
+            for (unsigned int i = 0; i < W * H; i++, in += samples) {
+                // alpha is linear in the samples too
+                std::uint32_t out = averageChannel(in, 24) << 24;
+                for (int shift = 0; shift < 24; shift += 8) {
+                    float sum = 0;
+                    for (int s = 0; s < samples; s++)
+                        sum += toLinear[(in[s] >> shift) & 0xffu];
+                    // rounded, the encoding is within a quarter of a step of the inverse of toLinear
+                    float encoded = 255 * Colors::linearToSRGB(sum / samples) + .5f;
+                    out |= std::min(255u, std::uint32_t(encoded)) << shift;
+                }
+                fb.buffer[i] = out;
+            }
+        }
+
+    private:
+        // average of the 8 bits channel at shift of the samples, rounded to the closest value
+        static std::uint32_t averageChannel(const std::uint32_t *in, int shift) {
+            std::uint32_t sum = samples / 2;
+            for (int s = 0; s < samples; s++)
+                sum += (in[s] >> shift) & 0xffu;
+            return sum / samples;
+        }
+    };
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_SRL_MULTISAMPLE_H
@@ -6,9 +6,14 @@
 #define GRAPHICSPROGRAMMINGEXERCISES_RENDERER_H
 
 #include <vector>
+#include <memory>
+#include <thread>
 #include <algorithm>
 #include "glm/glm.hpp"
 #include "srl_types.h"
+#include "srl_color.h"
+#include "srl_vertex_transform.h"
+#include "srl_thread_pool.h"
 
 
 namespace srl {
@@ -17,7 +22,7 @@ namespace srl {
     public:
 
         // render vertices with mvp transformation in the fb framebuffer
-        void render(const std::vector<vertex> &vts,
+        virtual void render(const std::vector<vertex> &vts,
                             const glm::mat4 &m,
                             const glm::mat4 &vp,
                             CustomFrameBuffer <uint32_t> &fb,
@@ -27,28 +32,173 @@ namespace srl {
             //  to make the Software Render Library work, you have to call all methods
             //  in this class, in the right order and with the right parameters.
 
-            std::vector<vertex> _vts = vts; // copy all vertices from vts to _vts (since vts is a const)
-            std::vector<fragment> _frs;    // vector that will store the fragments
             glm::mat4 modelViewProjection = vp * m; // the matrix that transform points from local space to clipping space
 
-            processVertices(modelViewProjection, _vts);
-            assemblePrimitives(_vts);
+            // the transformed vertices are written to the vertex cache, so vts (a const) is not copied
+            processVertices(modelViewProjection, vts, m_vertexCache);
+            assemblePrimitives(m_vertexCache.clip);
+            renderPrimitives(fb, db);
+
+            //  MIND THAT THE METHODS BELOW ARE NOT DECLARED/DEFINED IN THE RIGHT ORDER!
+
+        }
+
+        // render indexed primitives: each vertex of vts is transformed (and divided by w) only once, and indices has
+        // the indices (in vts) of the vertices of each primitive, e.g. three per triangle
+        virtual void render(const std::vector<vertex> &vts,
+                            const std::vector<unsigned int> &indices,
+                            const glm::mat4 &m,
+                            const glm::mat4 &vp,
+                            CustomFrameBuffer <uint32_t> &fb,
+                            CustomFrameBuffer <float> &db) {
+            glm::mat4 modelViewProjection = vp * m;
+
+            processVertices(modelViewProjection, vts, m_vertexCache);
+            assembleIndexedPrimitives(m_vertexCache.clip, indices);
+            renderPrimitives(fb, db);
+        }
+
+        virtual ~Renderer(){};
+
+        // rasterize, shade and depth test each pixel in place instead of storing all the fragments of the frame
+        // (only if the renderer implements streamPrimitives, the fragment stream is used otherwise)
+        bool m_streaming = false;
+
+        // sRGB encoding and dithering of the colors written to the frame buffer
+        Colors::Encoding m_colorEncoding;
+
+        // number of threads, 0 == one per core. the vertices of large draws are processed in parallel, and renderers
+        // with parallel stages (e.g. the binning renderer) use them too
+        unsigned int m_numThreads = 0;
+
+    protected:
+        // post-transform vertex cache, with the same indices as the vertex list of the draw
+        struct VertexCache {
+            // vertices in clipping space (after the vertex processing)
+            std::vector<vertex> clip;
+            // vertices after the perspective division, only valid if w > 0
+            std::vector<vertex> divided;
+            // outcodes of the vertices in clipping space (see Outcode), computed with the guard band of the renderer
+            std::vector<std::uint16_t> outcodes;
+        };
+
+        // the pipeline after the primitive assembly
+        void renderPrimitives(CustomFrameBuffer <uint32_t> &fb, CustomFrameBuffer <float> &db) {
             clipPrimitives();
             divideByW();
             toScreenSpace(fb.W, fb.H);
             backfaceCulling();
-            rasterPrimitives(_frs);
-            processFragments(_frs);
-            writeToFrameBuffer(_frs, fb, db);
+            setupPrimitives();
+            // the fused path shades and depth tests the pixels while rasterizing, without the fragment stream
+            if (useStreaming() && streamPrimitives(fb, db))
+                return;
+            rasterPrimitives(m_fragments);
+            processFragments(m_fragments);
+            writeToFrameBuffer(m_fragments, fb, db, m_colorEncoding);
+        }
 
-            //  MIND THAT THE METHODS BELOW ARE NOT DECLARED/DEFINED IN THE RIGHT ORDER!
+        // the vertex cache used by the stages of the pipeline
+        virtual const VertexCache &vertexCache() const { return m_vertexCache; }
+
+        // true if the pipeline should use streamPrimitives, renderers with modes that only work there can force it
+        virtual bool useStreaming() const { return m_streaming; }
 
+        // perform vertex operations in the vertex stream (i.e. the equivalent to a vertex shaders), the vertices in
+        // [first, last) of vIn are written to the same indices of the cache (which must have the size of vIn).
+        // renderers with a programmable vertex shader override it, it is called once per draw (or range of vertices)
+        virtual void processVertices(const glm::mat4 &mvp, const std::vector<vertex> &vIn, VertexCache &cache,
+                                     size_t first, size_t last) const {
+            // this is the equivalent to a vertex shaders, the point and line renderers have no guard band
+            transformVertices(mvp, vIn, cache, first, last, 1.f);
         }
 
-        virtual ~Renderer(){};
-    private:
+        // true if processVertices can be called from several threads at once for ranges of the same draw. the built-in
+        // vertex processing can, renderers that call user code (e.g. a vertex shader) return false
+        virtual bool parallelVertexProcessing() const { return true; }
+
+        // processVertices for all of vIn, large vertex lists are split in ranges that are processed by all threads
+        // (only if parallelVertexProcessing, the calling thread processes all of them otherwise)
+        void processVertices(const glm::mat4 &mvp, const std::vector<vertex> &vIn, VertexCache &cache) {
+            cache.clip.resize(vIn.size());
+            cache.divided.resize(vIn.size());
+            cache.outcodes.resize(vIn.size());
+
+            // big enough that the threads don't fight over cache lines or wait for each other
+            const size_t rangeSize = 16384;
+            unsigned int numRanges = (unsigned int) ((vIn.size() + rangeSize - 1) / rangeSize);
+            if (numRanges <= 1 || !parallelVertexProcessing()) {
+                processVertices(mvp, vIn, cache, 0, vIn.size());
+                return;
+            }
+            threadPool().parallelFor(numRanges, [&](unsigned int r){
+                processVertices(mvp, vIn, cache, r * rangeSize, std::min(vIn.size(), (r + 1) * rangeSize));
+            });
+        }
+
+        // the vertex processing without vertex shader: the positions of the vertices in [first, last) of vIn are
+        // transformed by mvp in SIMD batches, with their outcodes for the guard band guardBand (see transformPositions)
+        static void transformVertices(const glm::mat4 &mvp, const std::vector<vertex> &vIn, VertexCache &cache,
+                                      size_t first, size_t last, float guardBand) {
+            transformPositions(mvp, vIn.data() + first, last - first, guardBand,
+                               [&](size_t i, const glm::vec4 &pos, int code){
+                vertex vtx = vIn[first + i];
+                vtx.pos = pos;
+                cache.clip[first + i] = vtx;
+                cache.divided[first + i] = perspectiveDivision(vtx);
+                cache.outcodes[first + i] = (std::uint16_t) code;
+            });
+        }
+
+        // the pool of m_numThreads threads, created again when the number of threads changes
+        ThreadPool &threadPool() {
+            unsigned int numThreads = m_numThreads > 0 ? m_numThreads : std::max(1u, std::thread::hardware_concurrency());
+            if (!m_pool || m_pool->size() != numThreads)
+                m_pool.reset(new ThreadPool(numThreads));
+            return *m_pool;
+        }
+
+        // clipping space to normalized device coordinates.
+        // the division of position x, y and z coordinates will place all vertices in the normalized device coordinates
+        // however, we divide all parameters (not only position) to perform hyperbolic interpolation later on
+        static vertex perspectiveDivision(vertex vtx) {
+            vtx.pos.z = vtx.pos.z / vtx.pos.w;
+            return vtx / vtx.pos.w;
+        }
+
+        // perform the fragment operations of a single fragment (i.e. the fragment shader)
+        static void processFragment(fragment &frg) {
+            // example: uncomment this to make all fragments darker
+            // frg.col = frg.col * 0.5f;
+        }
+
+        // depth test a single fragment and copy its color (converted with encoding) to the frame buffer
+        static void writeFragment(const fragment &frg, CustomFrameBuffer <uint32_t> &fb, CustomFrameBuffer <float> &db,
+                                  const Colors::Encoding &encoding) {
+            glm::ivec2 pos = frg.pos;
+
+            // make sure it is within framebuffer range (it won't be if we do not clip)
+            if (pos.x < 0 || pos.x >= (int) fb.W || pos.y < 0 || pos.y >= (int) fb.H)
+                return;
+
+            // z/depth-test algorithm:
+            if (frg.depth < db.valueAt(pos.x, pos.y)) {
+                // is the new fragment closer? Then update the color and the depth buffer
+                fb.paintAt(pos.x, pos.y, Colors::toRGBA32(frg.col, encoding, pos.x, pos.y));
+                db.paintAt(pos.x, pos.y, frg.depth);
+            }
+        }
+
+    protected:
 
         virtual void assemblePrimitives(const std::vector<vertex> &vts) = 0;
+        // create the primitives from the vertices in the order of indices, by default the indexed vertices are copied
+        // to a list in the order of the primitives
+        virtual void assembleIndexedPrimitives(const std::vector<vertex> &vts, const std::vector<unsigned int> &indices) {
+            m_assembled.resize(indices.size());
+            for (size_t i = 0; i < indices.size(); i++)
+                m_assembled[i] = vts[indices[i]];
+            assemblePrimitives(m_assembled);
+        }
         // performs the perspective division
 
         // remove all geometry outside the visible volume (performed in clipping space)
@@ -56,6 +206,8 @@ namespace srl {
         // test if the surface of the primitive is visible to the camera
         // only used when rendering triangles.
         virtual void backfaceCulling(){};
+        // per primitive computations for the rasterization (e.g. the interpolation gradients of the triangles)
+        virtual void setupPrimitives(){};
 
         // (i.e. transforms from the clipping space to the normalized device coordinates)
         virtual void divideByW() = 0;
@@ -63,44 +215,61 @@ namespace srl {
         virtual void toScreenSpace(int width, int height) = 0;
         // generate the fragments, with final window pixel locations, used to render the primitives
         virtual void rasterPrimitives(std::vector<fragment> &outFrs) = 0;
+        // rasterize the primitives and write their pixels directly to the frame buffer (processFragment and
+        // writeFragment for each pixel), returns false if the renderer doesn't support it
+        virtual bool streamPrimitives(CustomFrameBuffer <uint32_t> &/*fb*/, CustomFrameBuffer <float> &/*db*/) { return false; }
 
-        // perform vertex operations in the vertex stream (i.e. the equivalent to a vertex shaders)
-        static void processVertices(const glm::mat4 &mvp, std::vector<vertex> &vInOut) {
-            for (auto &vtx : vInOut){
-                // this is the equivalent to a vertex shaders
-                vtx.pos = mvp * vtx.pos;
-            }
-        }
-
-        // perform fragment operations in the fragment stream (i.e. fragment shaders)
-        static void processFragments(std::vector<fragment>& fInOut) {
+        // perform fragment operations in the fragment stream (i.e. fragment shaders),
+        // renderers with a programmable fragment shader override it
+        virtual void processFragments(std::vector<fragment>& fInOut) const {
             // fragment shaders - not necessary for now since we are not modifying the color
             for (auto &frg : fInOut){
-                // example: uncomment this to make all fragments darker
-                // frg.col = frg.col * 0.5f;
+                processFragment(frg);
             }
         }
 
         // fragment operations and copy color to frame buffer
-        // blending test and z/depth-buffer can come here
-        static void writeToFrameBuffer(const std::vector<fragment> &frs, CustomFrameBuffer <uint32_t> &fb, CustomFrameBuffer <float> &db) {
-			int width = fb.W;
-			int height = fb.H;
-            for (int i = 0, size = frs.size(); i < size; i++) {
-                glm::ivec2 pos = frs[i].pos;
-
-                // make sure it is within framebuffer range (it won't be if we do not clip)
-				if (pos.x < 0 || pos.x >= width || pos.y < 0 || pos.y >= height)
-					continue;
-
-				// z/depth-test algorithm:
-				if (frs[i].depth < db.valueAt(pos.x, pos.y)) {
-                    // is the new fragment closer? Then update the color and the depth buffer
-					fb.paintAt(pos.x, pos.y, Colors::toRGBA32(frs[i].col));
-                    db.paintAt(pos.x, pos.y, frs[i].depth);
-				}
+        // blending test and z/depth-buffer can come here.
+        // the fragments are depth tested in batches, and the colors of those that pass are converted together
+        // (see Colors::toRGBA32) before they are written. the depth buffer is updated during the test, so a later
+        // fragment of the batch at the same pixel is tested against it, and the colors are written in order
+        static void writeToFrameBuffer(const std::vector<fragment> &frs, CustomFrameBuffer <uint32_t> &fb, CustomFrameBuffer <float> &db,
+                                       const Colors::Encoding &encoding) {
+            const size_t batchSize = 64;
+            const fragment *visible[batchSize];
+            Colors::color colors[batchSize];
+            std::uint32_t rgba[batchSize];
+            for (size_t first = 0; first < frs.size(); first += batchSize) {
+                size_t n = std::min(batchSize, frs.size() - first), visibleCount = 0;
+                for (size_t i = first; i < first + n; i++) {
+                    const fragment &frg = frs[i];
+                    if (frg.pos.x < 0 || frg.pos.x >= (int) fb.W || frg.pos.y < 0 || frg.pos.y >= (int) fb.H)
+                        continue;
+                    if (frg.depth < db.valueAt(frg.pos.x, frg.pos.y)) {
+                        db.paintAt(frg.pos.x, frg.pos.y, frg.depth);
+                        colors[visibleCount] = frg.col;
+                        visible[visibleCount++] = &frg;
+                    }
+                }
+
+                if (encoding.dither)
+                    Colors::toRGBA32(colors, rgba, visibleCount, encoding.srgb, [&](size_t i) {
+                        return Colors::ditherThreshold(visible[i]->pos.x, visible[i]->pos.y);
+                    });
+                else
+                    Colors::toRGBA32(colors, rgba, visibleCount, encoding.srgb, [](size_t) { return 0.f; });
+
+                for (size_t i = 0; i < visibleCount; i++)
+                    fb.paintAt(visible[i]->pos.x, visible[i]->pos.y, rgba[i]);
             }
         }
+
+        // part of the class so that we avoid reallocating memory every frame
+        VertexCache m_vertexCache;
+        std::vector<vertex> m_assembled;
+        std::vector<fragment> m_fragments;
+        // shared_ptr so that the renderers stay copyable, a copy uses the same threads until it needs a different number
+        std::shared_ptr<ThreadPool> m_pool;
     };
 }
 
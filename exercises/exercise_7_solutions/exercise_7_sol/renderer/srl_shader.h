@@ -0,0 +1,141 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_SRL_SHADER_H
+#define ITU_GRAPHICS_PROGRAMMING_SRL_SHADER_H
+
+#include <type_traits>
+#include "srl_types.h"
+#include "srl_texture.h"
+
+namespace srl {
+
+    // the attributes of the vertices that are interpolated for the fragment shader, known at compile time so that the
+    // rasterization never computes the others (they are left at zero in the fragments).
+    // the depth and hypInterp (1 / w) are always interpolated, they are needed for the depth test and the correction.
+    // with UVDerivatives the fragments also get the derivatives of uv (fragment::dUVdx and dUVdy), e.g. for the level
+    // of detail of a texture
+    template <bool Color, bool Normal, bool UV, bool UVDerivatives = false>
+    struct Varyings {
+        static const bool color = Color;
+        static const bool normal = Normal;
+        static const bool uv = UV || UVDerivatives;
+        static const bool uvDerivatives = UVDerivatives;
+
+        // the interpolated attributes of the triangle at the window position at (see triangle::interpolateAt)
+        static vertex interpolateAt(const triangle &tri, glm::vec2 at) {
+            float x = at.x - tri.v3.pos.x, y = at.y - tri.v3.pos.y;
+            vertex v;
+            v.pos.z = tri.v3.pos.z + tri.ddx.pos.z * x + tri.ddy.pos.z * y;
+            v.hypInterp = tri.v3.hypInterp + tri.ddx.hypInterp * x + tri.ddy.hypInterp * y;
+            if (Color) v.col = tri.v3.col + tri.ddx.col * x + tri.ddy.col * y;
+            if (Normal) v.norm = tri.v3.norm + tri.ddx.norm * x + tri.ddy.norm * y;
+            if (uv) v.uv = tri.v3.uv + tri.ddx.uv * x + tri.ddy.uv * y;
+            return v;
+        }
+
+        // adds the gradient d (e.g. triangle::ddx) to the interpolated attributes v
+        static void add(vertex &v, const vertex &d) {
+            v.pos.z += d.pos.z;
+            v.hypInterp += d.hypInterp;
+            if (Color) v.col += d.col;
+            if (Normal) v.norm += d.norm;
+            if (uv) v.uv += d.uv;
+        }
+
+        // fragment at pixel location pxl of the triangle tri with the interpolated attributes v, after the hyperbolic
+        // correction
+        static fragment createFragment(const triangle &tri, const glm::ivec2 &pxl, const vertex &v) {
+            fragment frag{};
+            float w = 1.f / v.hypInterp;
+
+            frag.pos = pxl;
+            frag.depth = v.pos.z * w;
+            if (Color) frag.col = v.col * w;
+            if (Normal) frag.norm = v.norm * w;
+            if (uv) frag.uv = v.uv * w;
+            if (UVDerivatives) quadDerivatives(tri, pxl, frag.dUVdx, frag.dUVdy);
+
+            return frag;
+        }
+
+        // derivatives of uv as in the 2x2 pixel quads of a GPU: the differences between the pixels of the quad of pxl
+        // along x and y, the same for the 4 pixels. they are computed from the planes of the triangle, so the pixels
+        // of the quad outside of the triangle don't need to be rasterized
+        static void quadDerivatives(const triangle &tri, const glm::ivec2 &pxl, glm::vec2 &dUVdx, glm::vec2 &dUVdy) {
+            glm::vec2 quad(pxl.x & ~1, pxl.y & ~1);
+            glm::vec2 uv00 = uvAt(tri, quad);
+            dUVdx = uvAt(tri, quad + glm::vec2(1, 0)) - uv00;
+            dUVdy = uvAt(tri, quad + glm::vec2(0, 1)) - uv00;
+        }
+
+        // uv of the triangle at the window position at, after the hyperbolic correction
+        static glm::vec2 uvAt(const triangle &tri, glm::vec2 at) {
+            float x = at.x - tri.v3.pos.x, y = at.y - tri.v3.pos.y;
+            glm::vec2 uvHyp = tri.v3.uv + tri.ddx.uv * x + tri.ddy.uv * y;
+            return uvHyp / (tri.v3.hypInterp + tri.ddx.hypInterp * x + tri.ddy.hypInterp * y);
+        }
+    };
+
+    typedef Varyings<true, true, true> AllVaryings;
+
+    // the programmable stages of the pipeline. a shader is any type with a varyings type and these two methods,
+    // the renderers take it as a template parameter so that the compiler can inline them in the vertex and raster loops.
+    // the default shader does what the fixed stages of the Renderer do
+    struct DefaultShader {
+        typedef AllVaryings varyings;
+
+        // vertex shader, from local space to clipping space
+        vertex shadeVertex(const vertex &vtx, const glm::mat4 &mvp) const {
+            vertex out = vtx;
+            out.pos = mvp * vtx.pos;
+            return out;
+        }
+
+        // fragment shader, changes the fragment in place
+        void shadeFragment(fragment &frg) const {
+            // example: uncomment this to make all fragments darker
+            // frg.col = frg.col * 0.5f;
+        }
+    };
+
+    // the default shader with the interpolated color modulated by a texture, filtered at the level of detail of the
+    // 2x2 pixel quad of each fragment. without texture it is the same as the default shader
+    struct TexturedShader : DefaultShader {
+        typedef Varyings<true, true, true, true> varyings;
+
+        const Texture *m_texture = nullptr;
+        Texture::Filter m_filter = Texture::trilinear;
+
+        void shadeFragment(fragment &frg) const {
+            if (!m_texture || m_texture->empty())
+                return;
+            frg.col *= m_texture->sample(frg.uv, m_texture->lod(frg.dUVdx, frg.dUVdy), m_filter);
+        }
+    };
+
+    // true if the vertex shader of Shader is the one of DefaultShader (e.g. inherited by TexturedShader), which only
+    // transforms the position, so the renderers can transform the vertices in SIMD batches without calling it
+    template <typename Shader>
+    struct hasDefaultVertexShader
+            : std::is_same<decltype(&Shader::shadeVertex), decltype(&DefaultShader::shadeVertex)> {};
+
+    // a shader made of two functors or lambdas, see makeShader
+    template <typename VertexShader, typename FragmentShader, typename VaryingsT = AllVaryings>
+    struct LambdaShader {
+        typedef VaryingsT varyings;
+
+        VertexShader m_vertexShader;
+        FragmentShader m_fragmentShader;
+
+        vertex shadeVertex(const vertex &vtx, const glm::mat4 &mvp) const { return m_vertexShader(vtx, mvp); }
+        void shadeFragment(fragment &frg) const { m_fragmentShader(frg); }
+    };
+
+    // shader from a vertex shader vertex(const vertex &, const glm::mat4 &mvp) and a fragment shader void(fragment &),
+    // e.g. ShadedTriangleRenderer<decltype(shader)> renderer(shader). ShadedTriangleRenderer calls them from the thread
+    // that renders, ShadedBinningRenderer from all of its threads at once, so they must be thread safe there
+    template <typename VaryingsT = AllVaryings, typename VertexShader, typename FragmentShader>
+    LambdaShader<VertexShader, FragmentShader, VaryingsT> makeShader(VertexShader vertexShader, FragmentShader fragmentShader) {
+        return LambdaShader<VertexShader, FragmentShader, VaryingsT>{vertexShader, fragmentShader};
+    }
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_SRL_SHADER_H
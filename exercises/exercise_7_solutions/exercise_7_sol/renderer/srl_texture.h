@@ -0,0 +1,11 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_SRL_TEXTURE_H
+#define ITU_GRAPHICS_PROGRAMMING_SRL_TEXTURE_H
+
+#include <swr/texture.h>
+
+namespace srl {
+    // the mipmapped texture is shared with the ray tracer of exercise 10
+    using swr::Texture;
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_SRL_TEXTURE_H
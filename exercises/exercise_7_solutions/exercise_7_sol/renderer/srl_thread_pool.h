@@ -0,0 +1,101 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_SRL_THREAD_POOL_H
+#define ITU_GRAPHICS_PROGRAMMING_SRL_THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+
+namespace srl {
+
+    // a pool of persistent worker threads, so that we don't create threads every frame.
+    // the items of a parallelFor are taken in order from a shared counter by whichever thread is free
+    class ThreadPool {
+    public:
+        // numThreads includes the thread calling parallelFor, which also does work
+        explicit ThreadPool(unsigned int numThreads) {
+            if (numThreads == 0) numThreads = 1;
+            for (unsigned int i = 1; i < numThreads; i++)
+                m_workers.emplace_back(&ThreadPool::workerLoop, this);
+        }
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_wakeUp.notify_all();
+            for (auto &w : m_workers)
+                w.join();
+        }
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        unsigned int size() const { return (unsigned int) m_workers.size() + 1; }
+
+        // calls task(i) for every i in [0, count) using all threads, and returns when all calls are done
+        void parallelFor(unsigned int count, const std::function<void(unsigned int)> &task) {
+            if (m_workers.empty() || count <= 1) {
+                for (unsigned int i = 0; i < count; i++)
+                    task(i);
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_job = &task;
+                m_count = count;
+                m_next = 0;
+                m_busyWorkers = (unsigned int) m_workers.size();
+                m_generation++;
+            }
+            m_wakeUp.notify_all();
+
+            work();
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_allDone.wait(lock, [this] { return m_busyWorkers == 0; });
+            m_job = nullptr;
+        }
+
+    private:
+        void work() {
+            for (unsigned int i = m_next++; i < m_count; i = m_next++)
+                (*m_job)(i);
+        }
+
+        void workerLoop() {
+            unsigned int seenGeneration = 0;
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_wakeUp.wait(lock, [&] { return m_stop || m_generation != seenGeneration; });
+                    if (m_stop) return;
+                    seenGeneration = m_generation;
+                }
+
+                work();
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (--m_busyWorkers == 0)
+                    m_allDone.notify_one();
+            }
+        }
+
+        std::vector<std::thread> m_workers;
+
+        std::mutex m_mutex;
+        std::condition_variable m_wakeUp, m_allDone;
+        const std::function<void(unsigned int)> *m_job = nullptr;
+        unsigned int m_count = 0;
+        std::atomic<unsigned int> m_next{0};
+        unsigned int m_generation = 0;
+        unsigned int m_busyWorkers = 0;
+        bool m_stop = false;
+    };
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_SRL_THREAD_POOL_H
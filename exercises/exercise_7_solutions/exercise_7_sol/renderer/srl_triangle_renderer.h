@@ -8,29 +8,81 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/transform.hpp>
 #include "srl_renderer.h"
+#include "srl_shader.h"
 #include "rasterizer/trianglerasterizer.h"
+#include "rasterizer/blockrasterizer.h"
+#include "srl_hierarchical_z.h"
+#include "srl_multisample.h"
 #include <glm/gtc/matrix_access.hpp>
 #include <iostream>
+#include <limits>
+#include <cmath>
 #include "srl_types.h"
 
 namespace srl {
 
-    class TriangleRenderer : public Renderer {
+    // triangle renderer with the vertex and fragment shaders of Shader (see DefaultShader), which are inlined in the
+    // vertex and raster loops. only the attributes in Shader::varyings are interpolated
+    template <typename Shader>
+    class ShadedTriangleRenderer : public Renderer {
     public:
-        bool m_clipToFrustum = true;
+        typedef typename Shader::varyings varyings;
+
+        explicit ShadedTriangleRenderer(const Shader &shader = Shader()) : m_shader(shader) {}
+
+        // the shader, e.g. to change its parameters between draws
+        Shader &shader() { return m_shader; }
+        const Shader &shader() const { return m_shader; }
 
-    private:
+        bool m_clipToFrustum = true;
+        // rasterize with the block_rasterizer (edge functions over 8x8 pixel blocks) instead of the scanline
+        // triangle_rasterizer, both cover the same pixels
+        bool m_useBlockRasterizer = false;
+        // reject the triangles and blocks of pixels behind what was already drawn with a hierarchical z buffer
+        // (only used with m_streaming and the block rasterizer)
+        bool m_hierarchicalZ = false;
+        // only clip the triangles that cross the near or far planes or that leave the guard band, the parts of the
+        // other triangles outside of the screen are skipped by the scissor of the rasterizers
+        bool m_guardBandClipping = false;
+        // half width and height of the guard band in normalized device coordinates (the screen is [-1, 1]),
+        // it limits how far from the screen the vertices of the rasterized triangles can be
+        float m_guardBand = 4.f;
+        // rasterize with vertices in fixed point (block_rasterizer::subpixel_bits fractional bits) instead of rounding
+        // them to whole pixels, sampling the pixel centers with the top-left fill rule. the scanline rasterizer only
+        // works with whole pixels, so the block rasterizer is always used in this mode
+        bool m_subpixelPrecision = false;
+        // if not null, render to the samples of this buffer instead of the frame and depth buffers (which must have its
+        // size), with per sample coverage and depth test and one shading per pixel and triangle. the caller clears it
+        // before rendering and resolves it to the frame buffer after. it always uses the fused pipeline, the block
+        // rasterizer and subpixel precision, and not the hierarchical z buffer
+        MultisampleBuffer *m_multisample = nullptr;
+
+    protected:
+        bool useStreaming() const override { return m_streaming || m_multisample; }
 
         // create triangle primitives
         void assemblePrimitives(const std::vector<vertex> &vts) override {
             m_primitives.clear();
-            m_primitives.reserve(vts.size()/3);
+            assembleTriangles(vts, nullptr, 0, vts.size()/3);
+        }
 
-            for(int i = 0, size = vts.size()-2; i < size; i+=3){
+        // create triangle primitives from indexed vertices
+        void assembleIndexedPrimitives(const std::vector<vertex> &vts, const std::vector<unsigned int> &indices) override {
+            m_primitives.clear();
+            assembleTriangles(vts, indices.data(), 0, indices.size()/3);
+        }
+
+        // add the triangles in [first, last) to m_primitives, the vertices of triangle t are
+        // vts[indices[3t]], vts[indices[3t+1]] and vts[indices[3t+2]] (or vts[3t], ... without indices)
+        void assembleTriangles(const std::vector<vertex> &vts, const unsigned int *indices, size_t first, size_t last){
+            m_primitives.reserve(m_primitives.size() + last - first);
+
+            for(size_t i = first * 3, end = last * 3; i < end; i+=3){
                 triangle t;
-                t.v1 = vts[i];
-                t.v2 = vts[i+1];
-                t.v3 = vts[i+2];
+                t.indices = indices ? glm::ivec3(indices[i], indices[i+1], indices[i+2]) : glm::ivec3(i, i+1, i+2);
+                t.v1 = vts[t.indices.x];
+                t.v2 = vts[t.indices.y];
+                t.v3 = vts[t.indices.z];
 
                 m_primitives.push_back(t);
             }
@@ -69,7 +121,10 @@ namespace srl {
                 // whole triangle in the valid side of the half-space (or over the plane)
                 return true;
             }
-            else if (outCount == 3) {
+            // the vertices are not the ones in the vertex cache anymore
+            tIn.indices = glm::ivec3(-1);
+
+            if (outCount == 3) {
                 // whole triangle in the invalid side of the half-space
                 // reject this triangle
                 tIn.rejected = true;
@@ -128,33 +183,65 @@ namespace srl {
         }
 
 
-        // clip primitives so that they are contained within the render volume
+        // clip primitives so that they are contained within the render volume. the outcodes of the vertices (from the
+        // vertex processing) tell which sides each triangle has to be clipped against: none if it is inside, and with
+        // m_guardBandClipping only the near and far planes and the screen sides it crosses beyond the guard band
         void clipPrimitives() override {
+            const std::vector<std::uint16_t> &outcodes = vertexCache().outcodes;
+
+            // sides each primitive has to be clipped against, the triangles created by clipTriangle inherit them
+            m_clipSides.clear();
+            for(auto &tri : m_primitives) {
+                int c1 = outcodes[tri.indices.x];
+                int c2 = outcodes[tri.indices.y];
+                int c3 = outcodes[tri.indices.z];
+
+                int sides = 0;
+                if (c1 & c2 & c3 & frustumPlanes) {
+                    // all the vertices are outside of the same frustum plane
+                    tri.rejected = true;
+                }
+                else if (!m_guardBandClipping) {
+                    sides = (c1 | c2 | c3) & frustumPlanes;
+                }
+                else {
+                    int any = c1 | c2 | c3;
+                    // triangles inside the guard band are only clipped in z, so that w > 0 after the perspective division
+                    sides = any & (outsideNear | outsideFar);
+                    if (any & beyondRightGuard) sides |= outsideRight;
+                    if (any & beyondTopGuard) sides |= outsideTop;
+                    if (any & beyondLeftGuard) sides |= outsideLeft;
+                    if (any & beyondBottomGuard) sides |= outsideBottom;
+                }
+                m_clipSides.push_back(sides);
+            }
+
             for (int side = 0; side < 6; side ++){
                 for(int i = 0, size = m_primitives.size(); i < size; i++){
-                    if (!m_primitives[i].rejected)
-                        clipTriangle(m_primitives[i], side);
+                    if (m_primitives[i].rejected || !(m_clipSides[i] & (1 << side)))
+                        continue;
+                    clipTriangle(m_primitives[i], side);
+                    if (m_clipSides.size() < m_primitives.size())
+                        m_clipSides.push_back(m_clipSides[i]);
                 }
             }
         }
 
         // perspective division (canonical perspective volume to normalized device coordinates)
         void divideByW() override {
+            // the vertices that were not clipped were already divided once in the vertex cache
+            const std::vector<vertex> &divided = vertexCache().divided;
             for(auto &tri : m_primitives) {
-                // the division of position x, y and z coordinates will place all vertices in the normalized device coordinates
-                // however, we divide all parameters (not only position) to perform hyperbolic interpolation later on
-                tri.v1.pos.z = tri.v1.pos.z / tri.v1.pos.w;
-                tri.v1 = tri.v1 / tri.v1.pos.w;
-                tri.v2.pos.z = tri.v2.pos.z / tri.v2.pos.w;
-                tri.v2 = tri.v2 / tri.v2.pos.w;
-                tri.v3.pos.z = tri.v3.pos.z / tri.v3.pos.w;
-                tri.v3 = tri.v3 / tri.v3.pos.w;
-
+                tri.v1 = tri.indices.x >= 0 ? divided[tri.indices.x] : perspectiveDivision(tri.v1);
+                tri.v2 = tri.indices.y >= 0 ? divided[tri.indices.y] : perspectiveDivision(tri.v2);
+                tri.v3 = tri.indices.z >= 0 ? divided[tri.indices.z] : perspectiveDivision(tri.v3);
             }
         }
 
         // normalized device coordinates to window coordinates
         void toScreenSpace(int width, int height) override  {
+            m_width = width;
+            m_height = height;
             float halfW = width / 2;
             float halfH = height / 2;
             glm::mat4 toWindowSpace = glm::scale(glm::vec3(halfW, halfH, 1.f)) * glm::translate(glm::vec3(1.f, 1.f, 0.f));
@@ -183,6 +270,40 @@ namespace srl {
             }
         }
 
+        // the vertex shader for each vertex in [first, last), with the outcodes for the guard band of the clipping
+        void processVertices(const glm::mat4 &mvp, const std::vector<vertex> &vIn, VertexCache &cache,
+                             size_t first, size_t last) const override {
+            if (hasDefaultVertexShader<Shader>::value) {
+                transformVertices(mvp, vIn, cache, first, last, m_guardBand);
+                return;
+            }
+            for (size_t i = first; i < last; i++){
+                vertex vtx = m_shader.shadeVertex(vIn[i], mvp);
+                cache.clip[i] = vtx;
+                cache.divided[i] = perspectiveDivision(vtx);
+                cache.outcodes[i] = (std::uint16_t) outcode(vtx.pos, m_guardBand);
+            }
+        }
+
+        // the vertex shader of Shader isn't required to be thread safe, so only the built-in one runs on several threads
+        bool parallelVertexProcessing() const override {
+            return hasDefaultVertexShader<Shader>::value;
+        }
+
+        // the fragment shader for each fragment of the fragment stream
+        void processFragments(std::vector<fragment>& fInOut) const override {
+            for (auto &frg : fInOut)
+                m_shader.shadeFragment(frg);
+        }
+
+        // compute the interpolation gradients of the visible triangles, only for the attributes in varyings
+        void setupPrimitives() override {
+            for(auto &tri : m_primitives) {
+                if(!tri.rejected)
+                    tri.template setup<varyings::color, varyings::normal, varyings::uv>();
+            }
+        }
+
         // rasterize the triangle and generate the fragments (outFrs)
         void rasterPrimitives(std::vector<fragment> &outFrs) override {
             outFrs.clear();
@@ -192,41 +313,280 @@ namespace srl {
                 if(tri.rejected)
                     continue;
 
-                // vertices of the triangle, rounded to the closest integer (aka pixel location)
-                glm::ivec2 iv1(tri.v1.pos.x + .5f, tri.v1.pos.y + .5f);
-                glm::ivec2 iv2(tri.v2.pos.x + .5f, tri.v2.pos.y + .5f);
-                glm::ivec2 iv3(tri.v3.pos.x + .5f, tri.v3.pos.y + .5f);
-                // run the rasterization and collect all pixel locations
-                triangle_rasterizer rasterizer(iv1.x, iv1.y, iv2.x, iv2.y, iv3.x, iv3.y);
-                std::vector<glm::ivec2> pixels = rasterizer.all_pixels();
-
                 // create a fragment for each pixel
-                for (auto &pxl : pixels){
-                    fragment frag{};
+                rasterTriangle(tri, [&](const glm::ivec2 &pxl, const vertex &interp){
+                    outFrs.push_back(varyings::createFragment(tri, pxl, interp));
+                });
+            }
+        }
 
-                    frag.pos = pxl;
+        // rasterize the triangles and write their pixels to the frame buffer without creating the fragment stream.
+        // the depth test is done before interpolating the other attributes, so hidden pixels are never shaded
+        bool streamPrimitives(CustomFrameBuffer <uint32_t> &fb, CustomFrameBuffer <float> &db) override {
+            if (m_multisample) {
+                for(auto &tri : m_primitives) {
+                    if(!tri.rejected)
+                        rasterTriangleMSAA(tri, 0, 0, fb.W - 1, fb.H - 1, m_shader, m_colorEncoding, *m_multisample);
+                }
+                return true;
+            }
 
-                    // barycentric coordinates (in 2D projected space)
-                    glm::vec3 bar = tri.barycentricCoordinatesAt(pxl);
-                    // hyperbolic interpolation correction
-                    float hypInterp = bar.x * tri.v1.hypInterp + bar.y * tri.v2.hypInterp + bar.z * tri.v3.hypInterp;
-                    bar = bar / hypInterp;
-                    frag.depth = bar.x * tri.v1.pos.z + bar.y * tri.v2.pos.z + bar.z * tri.v3.pos.z;
-                    frag.col = bar.x * tri.v1.col + bar.y * tri.v2.col + bar.z * tri.v3.col;
-                    frag.norm = bar.x * tri.v1.norm + bar.y * tri.v2.norm + bar.z * tri.v3.norm;
-                    frag.uv = bar.x * tri.v1.uv + bar.y * tri.v2.uv + bar.z * tri.v3.uv;
+            if (m_hierarchicalZ && (m_useBlockRasterizer || m_subpixelPrecision)) {
+                // the depth buffer may have been cleared or written since the last frame
+                m_hiZ.build(db, 64);
+                for(auto &tri : m_primitives) {
+                    if(!tri.rejected)
+                        rasterTriangleHiZ(tri, 0, 0, fb.W - 1, fb.H - 1, m_subpixelPrecision, m_shader, m_colorEncoding, fb, db, m_hiZ);
+                }
+                return true;
+            }
 
+            for(auto &tri : m_primitives) {
+                if(tri.rejected)
+                    continue;
+
+                rasterTriangle(tri, [&](const glm::ivec2 &pxl, const vertex &interp){
+                    float depth;
+                    shadePixel(tri, pxl, interp, m_shader, m_colorEncoding, fb, db, depth);
+                });
+            }
+            return true;
+        }
+
+        // depth test, shade (with the fragment shader of shader) and write the pixel pxl of the triangle tri with the
+        // attributes interp (see Varyings::interpolateAt), returns true if it was written with depth.
+        // the depth test is done before the hyperbolic correction of the other attributes, so hidden pixels are never shaded
+        static bool shadePixel(const triangle &tri, const glm::ivec2 &pxl, const vertex &interp, const Shader &shader,
+                               const Colors::Encoding &encoding, CustomFrameBuffer <uint32_t> &fb, CustomFrameBuffer <float> &db, float &depth){
+            if (pxl.x < 0 || pxl.x >= (int) fb.W || pxl.y < 0 || pxl.y >= (int) fb.H)
+                return false;
+
+            depth = interp.pos.z / interp.hypInterp;
+            if (!(depth < db.valueAt(pxl.x, pxl.y)))
+                return false;
+
+            fragment frag = varyings::createFragment(tri, pxl, interp);
+            shader.shadeFragment(frag);
+            writeFragment(frag, fb, db, encoding);
+            return true;
+        }
+
+        // rasterize the part of the triangle inside of the pixel rectangle [x0, x1] x [y0, y1] with the block rasterizer,
+        // skipping the whole triangle or the blocks where it is behind the depths in hiZ, and keeping hiZ up to date
+        static void rasterTriangleHiZ(const triangle &tri, int x0, int y0, int x1, int y1, bool subpixel, const Shader &shader,
+                                      const Colors::Encoding &encoding, CustomFrameBuffer <uint32_t> &fb, CustomFrameBuffer <float> &db, HierarchicalZ &hiZ){
+            // the depth of a pixel is interpolated with hyperbolic correction, so it is N(x, y) / D(x, y), where N and D
+            // are linear functions of the window position. this is also true for the pixels outside of the triangle
+            // that are covered because the vertices were rounded, so the depths of the vertices are not a bound.
+            // if D is positive in a rectangle, the closest depth in it is at one of its corners
+            auto closestDepth = [&](int xa, int ya, int xb, int yb, float &zMin){
+                zMin = std::numeric_limits<float>::max();
+                glm::ivec2 corners[4] = {{xa, ya}, {xb, ya}, {xa, yb}, {xb, yb}};
+                for (auto &corner : corners) {
+                    float hypInterp = tri.v3.hypInterp + tri.ddx.hypInterp * (corner.x - tri.v3.pos.x) +
+                                      tri.ddy.hypInterp * (corner.y - tri.v3.pos.y);
+                    if (!(hypInterp > 0.f))
+                        return false;
+                    float z = tri.v3.pos.z + tri.ddx.pos.z * (corner.x - tri.v3.pos.x) + tri.ddy.pos.z * (corner.y - tri.v3.pos.y);
+                    zMin = std::min(zMin, z / hypInterp);
+                }
+                // the small margin covers the rounding errors of the interpolation
+                zMin -= 1e-5f;
+                return true;
+            };
+
+            glm::ivec2 iv1 = pixelAt(tri.v1.pos);
+            glm::ivec2 iv2 = pixelAt(tri.v2.pos);
+            glm::ivec2 iv3 = pixelAt(tri.v3.pos);
+            glm::ivec2 minPxl = glm::max(glm::min(glm::min(iv1, iv2), iv3), glm::ivec2(x0, y0));
+            glm::ivec2 maxPxl = glm::min(glm::max(glm::max(iv1, iv2), iv3), glm::ivec2(x1, y1));
+            float zMin;
+            if (closestDepth(minPxl.x, minPxl.y, maxPxl.x, maxPxl.y, zMin) &&
+                hiZ.rectOccluded(minPxl.x, minPxl.y, maxPxl.x, maxPxl.y, zMin))
+                return;
+
+            const int blockSize = block_rasterizer::block_size;
+            block_rasterizer rasterizer = blockRasterizer(tri, subpixel, x0, y0, x1, y1);
+            for (; rasterizer.more_blocks(); rasterizer.next_block()) {
+                int bx = rasterizer.x() / blockSize, by = rasterizer.y() / blockSize;
+                if (closestDepth(rasterizer.x(), rasterizer.y(), rasterizer.x() + blockSize - 1, rasterizer.y() + blockSize - 1, zMin) &&
+                    hiZ.blockOccluded(bx, by, zMin))
+                    continue;
+
+                int written = 0;
+                float writtenMax = -std::numeric_limits<float>::max();
+                visitBlock(rasterizer, tri, [&](const glm::ivec2 &pxl, const vertex &interp){
+                    float depth;
+                    if (shadePixel(tri, pxl, interp, shader, encoding, fb, db, depth)) {
+                        written++;
+                        writtenMax = std::max(writtenMax, depth);
+                    }
+                });
+
+                if (written == blockSize * blockSize)
+                    hiZ.blockOverwritten(bx, by, writtenMax);
+                else if (written > 0)
+                    hiZ.blockChanged(db, bx, by);
+            }
+        }
+
+        // rasterize the part of the triangle inside of the pixel rectangle [x0, x1] x [y0, y1] to the samples of ms.
+        // the coverage and the depth are per sample, but the fragment shader runs once per pixel with the attributes
+        // at the pixel position, if any of its samples is covered and passes the depth test
+        static void rasterTriangleMSAA(const triangle &tri, int x0, int y0, int x1, int y1, const Shader &shader,
+                                       const Colors::Encoding &encoding, MultisampleBuffer &ms){
+            const int samples = MultisampleBuffer::samples;
+            const int blockSize = block_rasterizer::block_size;
+            glm::ivec2 sv1 = subpixelAt(tri.v1.pos);
+            glm::ivec2 sv2 = subpixelAt(tri.v2.pos);
+            glm::ivec2 sv3 = subpixelAt(tri.v3.pos);
+            block_rasterizer rasterizer(sv1.x, sv1.y, sv2.x, sv2.y, sv3.x, sv3.y, block_rasterizer::subpixel_bits,
+                                        MultisampleBuffer::sampleOffsets(), samples, x0, y0, x1, y1);
+
+            // the depth at a sample is N / D, with N and D at the pixel position plus their gradients times the offset
+            float dz[samples], dHyp[samples];
+            for (int s = 0; s < samples; s++) {
+                glm::vec2 offset = MultisampleBuffer::sampleOffset(s);
+                dz[s] = tri.ddx.pos.z * offset.x + tri.ddy.pos.z * offset.y;
+                dHyp[s] = tri.ddx.hypInterp * offset.x + tri.ddy.hypInterp * offset.y;
+            }
 
-                    outFrs.push_back(frag);
+            for (; rasterizer.more_blocks(); rasterizer.next_block()) {
+                std::uint64_t sampleMask[samples];
+                for (int s = 0; s < samples; s++)
+                    sampleMask[s] = rasterizer.sample_coverage(s);
+
+                visitBlock(rasterizer, tri, [&](const glm::ivec2 &pxl, const vertex &interp){
+                    int bit = (pxl.y - rasterizer.y()) * blockSize + (pxl.x - rasterizer.x());
+                    bool shaded = false;
+                    std::uint32_t color = 0;
+                    for (int s = 0; s < samples; s++) {
+                        if (!((sampleMask[s] >> bit) & 1u))
+                            continue;
+                        float depth = (interp.pos.z + dz[s]) / (interp.hypInterp + dHyp[s]);
+                        float &sampleDepth = ms.depthAt(pxl.x, pxl.y, s);
+                        if (!(depth < sampleDepth))
+                            continue;
+                        if (!shaded) {
+                            fragment frag = varyings::createFragment(tri, pxl, interp);
+                            shader.shadeFragment(frag);
+                            color = Colors::toRGBA32(frag.col, encoding, pxl.x, pxl.y);
+                            shaded = true;
+                        }
+                        sampleDepth = depth;
+                        ms.colorAt(pxl.x, pxl.y, s) = color;
+                    }
+                });
+            }
+        }
+
+        // vertex position in window coordinates rounded to the closest integer (aka pixel location)
+        static glm::ivec2 pixelAt(const glm::vec4 &pos){
+            return glm::ivec2(pos.x + .5f, pos.y + .5f);
+        }
+
+        // vertex position in window coordinates in fixed point, with block_rasterizer::subpixel_bits fractional bits
+        static glm::ivec2 subpixelAt(const glm::vec4 &pos){
+            const float one = float(1 << block_rasterizer::subpixel_bits);
+            return glm::ivec2(std::floor(pos.x * one + .5f), std::floor(pos.y * one + .5f));
+        }
+
+        // block rasterizer for the pixels of the triangle inside of the pixel rectangle [x0, x1] x [y0, y1], with the
+        // vertices rounded to whole pixels or in fixed point (subpixel)
+        static block_rasterizer blockRasterizer(const triangle &tri, bool subpixel, int x0, int y0, int x1, int y1){
+            if (subpixel) {
+                glm::ivec2 sv1 = subpixelAt(tri.v1.pos);
+                glm::ivec2 sv2 = subpixelAt(tri.v2.pos);
+                glm::ivec2 sv3 = subpixelAt(tri.v3.pos);
+                return block_rasterizer(sv1.x, sv1.y, sv2.x, sv2.y, sv3.x, sv3.y, block_rasterizer::subpixel_bits,
+                                        x0, y0, x1, y1);
+            }
+
+            glm::ivec2 iv1 = pixelAt(tri.v1.pos);
+            glm::ivec2 iv2 = pixelAt(tri.v2.pos);
+            glm::ivec2 iv3 = pixelAt(tri.v3.pos);
+            return block_rasterizer(iv1.x, iv1.y, iv2.x, iv2.y, iv3.x, iv3.y, x0, y0, x1, y1);
+        }
+
+        // calls visit(pixel, attributes) for every pixel set in the coverage mask of the current block of the rasterizer,
+        // with the attributes of the triangle at the pixel (see Varyings::interpolateAt). they are computed at the start
+        // of each row of the block and then incremented by the gradient along x from pixel to pixel
+        template <typename Visitor>
+        static void visitBlock(const block_rasterizer &rasterizer, const triangle &tri, Visitor &&visit){
+            const int blockSize = block_rasterizer::block_size;
+            std::uint64_t mask = rasterizer.coverage();
+            for (int row = 0; mask; row++, mask >>= blockSize) {
+                unsigned int rowMask = (unsigned int) (mask & ((1u << blockSize) - 1));
+                if (!rowMask)
+                    continue;
+                glm::ivec2 pxl(rasterizer.x(), rasterizer.y() + row);
+                vertex interp = varyings::interpolateAt(tri, pxl);
+                for (; rowMask; rowMask >>= 1, pxl.x++, varyings::add(interp, tri.ddx)) {
+                    if (rowMask & 1u)
+                        visit(pxl, interp);
                 }
             }
         }
 
+        // calls visit(pixel, attributes) for every pixel set in the coverage masks of the blocks of the rasterizer
+        template <typename Visitor>
+        static void visitBlocks(block_rasterizer &rasterizer, const triangle &tri, Visitor &&visit){
+            for (; rasterizer.more_blocks(); rasterizer.next_block())
+                visitBlock(rasterizer, tri, visit);
+        }
+
+        // calls visit(pixel, attributes) for every pixel covered by the triangle, with the rasterizer selected by
+        // m_useBlockRasterizer, and the attributes of the triangle at the pixel (see Varyings::interpolateAt)
+        template <typename Visitor>
+        void rasterTriangle(const triangle &tri, Visitor &&visit){
+            if (m_useBlockRasterizer || m_subpixelPrecision) {
+                // run the rasterization block by block, a pixel for each bit set in the coverage mask
+                block_rasterizer rasterizer = blockRasterizer(tri, m_subpixelPrecision, 0, 0, m_width - 1, m_height - 1);
+                visitBlocks(rasterizer, tri, visit);
+                return;
+            }
+
+            // vertices of the triangle, rounded to the closest integer (aka pixel location)
+            glm::ivec2 iv1 = pixelAt(tri.v1.pos);
+            glm::ivec2 iv2 = pixelAt(tri.v2.pos);
+            glm::ivec2 iv3 = pixelAt(tri.v3.pos);
+
+            // run the rasterization pixel by pixel, only inside of the frame buffer. the attributes are incremented by
+            // the gradient along x from pixel to pixel, and computed again at the same columns as the rows of the blocks
+            // of the block rasterizer, so that both rasterizers give exactly the same attributes
+            const int blockSize = block_rasterizer::block_size;
+            triangle_rasterizer rasterizer(iv1.x, iv1.y, iv2.x, iv2.y, iv3.x, iv3.y, 0, 0, m_width - 1, m_height - 1);
+            glm::ivec2 next(std::numeric_limits<int>::min());
+            vertex interp;
+            for (; rasterizer.more_fragments(); rasterizer.next_fragment()) {
+                glm::ivec2 pxl(rasterizer.x(), rasterizer.y());
+                if (pxl == next && pxl.x % blockSize != 0) {
+                    varyings::add(interp, tri.ddx);
+                }
+                else {
+                    interp = varyings::interpolateAt(tri, glm::ivec2(pxl.x - pxl.x % blockSize, pxl.y));
+                    for (int i = pxl.x % blockSize; i > 0; i--)
+                        varyings::add(interp, tri.ddx);
+                }
+                visit(pxl, interp);
+                next = glm::ivec2(pxl.x + 1, pxl.y);
+            }
+        }
 
         // lists of triangle primitives, part of the class so that we avoid reallocating memory every frame
         std::vector<triangle> m_primitives;
+        // frustum sides (bits of Outcode) that each primitive has to be clipped against
+        std::vector<int> m_clipSides;
+        // size of the frame buffer, the block rasterizer doesn't generate fragments outside of it
+        int m_width = 0, m_height = 0;
+        // farthest depths of the blocks of the depth buffer, used by the streaming path with m_hierarchicalZ
+        HierarchicalZ m_hiZ;
+        // vertex and fragment shaders
+        Shader m_shader;
     };
 
+    typedef ShadedTriangleRenderer<DefaultShader> TriangleRenderer;
+
 }
 
 #endif //GRAPHICSPROGRAMMINGEXERCISES_OGLTRIANGLERENDERER_H
@@ -5,39 +5,18 @@
 #ifndef ITU_GRAPHICS_PROGRAMMING_SRL_TYPES_H
 #define ITU_GRAPHICS_PROGRAMMING_SRL_TYPES_H
 
-
+#include <vector>
+#include <algorithm>
+#include <swr/frame_buffer.h>
 
 namespace srl {
 
-    template<class T>
-    class CustomFrameBuffer {
-    public:
-        unsigned int W, H;
-        T *buffer;
-
-        CustomFrameBuffer(unsigned int width, unsigned int height): W(width), H(height) {
-            buffer = new T[W * H];
-        }
-
-        ~CustomFrameBuffer(){delete[] buffer;} // clean our memory
-
-        void clearBuffer(T value){
-            int size = W * H;
-            for (int i = 0; i < size; i++)
-                buffer[i] = value;
-        }
-
-        void paintAt(unsigned int x, unsigned int y, T value){
-            assert (x < W && y < H); // ensure valid position, crash if not (sooo dramatic!)
-            buffer[x + y * W] = value;
-        }
-
-        T valueAt(unsigned int x, unsigned int y){
-            assert (x < W && y < H);
-            return buffer[x + y * W];
-        }
-
-    };
+    // the frame buffer and its memory layouts are shared with the ray tracer of exercise 10
+    using swr::LinearLayout;
+    using swr::TiledLayout;
+    using swr::MortonLayout;
+    template<class T, class Layout = LinearLayout>
+    using CustomFrameBuffer = swr::FrameBuffer<T, Layout>;
 
     namespace Colors {
         // colors are 32 bits unsigned ints, so it is easy to upload to the GPU as a texture
@@ -57,8 +36,8 @@ namespace srl {
             // convert color to four 8 bits uint, packed in a 32 bits uint.
             // We do that because that is the proper format for the color buffer that renders to the screen
             color c_clamp = glm::clamp(c, 0.f, 1.f);
-            return (uint32_t(255 * c.r)) + (uint32_t(255 * c.g) << 8) +
-                   (uint32_t(255 * c.b) << 16) + (uint32_t(255 * c.a) << 24);
+            return (uint32_t(255 * c_clamp.r)) + (uint32_t(255 * c_clamp.g) << 8) +
+                   (uint32_t(255 * c_clamp.b) << 16) + (uint32_t(255 * c_clamp.a) << 24);
         }
     }
 
@@ -96,6 +75,8 @@ namespace srl {
         glm::ivec2 pos;
         glm::vec2 uv;
         float depth;
+        // derivatives of uv along the x and y axes of the window, only set if the shader asks for them
+        glm::vec2 dUVdx, dUVdy;
     };
 
 
@@ -118,22 +99,62 @@ namespace srl {
         vertex v3;
         glm::ivec2 p1, p2, p3;
         bool rejected = false;
+        // indices of the vertices in the vertex cache, -1 if the vertex was created or moved by clipping
+        glm::ivec3 indices = glm::ivec3(-1);
 
         glm::mat2x2 inverse = glm::mat2x2(1.0f);
         bool inverseReady = false;
 
+        // the attributes (divided by w, and hypInterp = 1 / w) are linear functions of the window position,
+        // the value at (x, y) is v3 + ddx * (x - v3.pos.x) + ddy * (y - v3.pos.y)
+        vertex ddx, ddy;
+
         glm::vec3 barycentricCoordinatesAt(glm::vec2 at){
             if(!inverseReady){
                 // we only need to compute this inverse once per triangle
                 inverse[0] = glm::vec2(v1.pos.x - v3.pos.x, v1.pos.y - v3.pos.y);
                 inverse[1] = glm::vec2(v2.pos.x - v3.pos.x, v2.pos.y - v3.pos.y);
                 inverse = glm::inverse(inverse);
+                inverseReady = true;
             }
             glm::vec3 barycentric = glm::vec3(inverse * (at - glm::vec2(v3.pos.x, v3.pos.y)), 0);
             barycentric.z = 1.0f - barycentric.x - barycentric.y;
 
             return barycentric;
         }
+
+        // triangle setup: computes the gradients ddx and ddy of the attributes once, after the vertices are in window
+        // coordinates, so that the rasterization only has to add them from pixel to pixel.
+        // the gradients of color, normal and uv are only computed if Color, Normal and UV are set (e.g. from the
+        // Varyings of a shader), the others are left at zero. pos and hypInterp are always computed
+        template <bool Color = true, bool Normal = true, bool UV = true>
+        void setup(){
+            // the barycentric coordinates of v1 and v2 grow by inverse[0] along x and by inverse[1] along y
+            barycentricCoordinatesAt(glm::vec2(v3.pos.x, v3.pos.y));
+            glm::vec2 b1(inverse[0].x, inverse[1].x), b2(inverse[0].y, inverse[1].y);
+            gradients(v1.pos, v2.pos, v3.pos, b1, b2, ddx.pos, ddy.pos);
+            gradients(v1.hypInterp, v2.hypInterp, v3.hypInterp, b1, b2, ddx.hypInterp, ddy.hypInterp);
+            ddx.col = ddy.col = Colors::color(0);
+            ddx.norm = ddy.norm = glm::vec4(0);
+            ddx.uv = ddy.uv = glm::vec2(0);
+            if (Color) gradients(v1.col, v2.col, v3.col, b1, b2, ddx.col, ddy.col);
+            if (Normal) gradients(v1.norm, v2.norm, v3.norm, b1, b2, ddx.norm, ddy.norm);
+            if (UV) gradients(v1.uv, v2.uv, v3.uv, b1, b2, ddx.uv, ddy.uv);
+        }
+
+        // gradients along x and y of an attribute with the values a1, a2 and a3 at the vertices, the barycentric
+        // coordinates of v1 and v2 grow by b1 and b2 (x along x, y along y)
+        template <typename T>
+        static void gradients(const T &a1, const T &a2, const T &a3, glm::vec2 b1, glm::vec2 b2, T &dx, T &dy) {
+            T d1 = a1 - a3, d2 = a2 - a3;
+            dx = d1 * b1.x + d2 * b2.x;
+            dy = d1 * b1.y + d2 * b2.y;
+        }
+
+        // attributes at the window position at, without the hyperbolic correction (they are still divided by w)
+        vertex interpolateAt(glm::vec2 at) const {
+            return v3 + ddx * (at.x - v3.pos.x) + ddy * (at.y - v3.pos.y);
+        }
     };
 }
 
@@ -0,0 +1,170 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_SRL_VERTEX_TRANSFORM_H
+#define ITU_GRAPHICS_PROGRAMMING_SRL_VERTEX_TRANSFORM_H
+
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "srl_types.h"
+
+// the vertices are transformed 8 at a time with AVX (enable it with the SRL_USE_AVX or SRL_USE_AVX2 cmake option), 4 at
+// a time with SSE2 (always available on x86-64) and one at a time with plain scalar code on other platforms
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SRL_VERTEX_AVX
+#define SRL_VERTEX_BATCH 8
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SRL_VERTEX_SSE
+#define SRL_VERTEX_BATCH 4
+#else
+#define SRL_VERTEX_BATCH 1
+#endif
+
+namespace srl {
+
+    // bits of the outcode of a vertex, the frustum planes have the same order as the sides of clipTriangle
+    enum Outcode {
+        outsideRight = 1 << 0, outsideTop = 1 << 1, outsideFar = 1 << 2,
+        outsideLeft = 1 << 3, outsideBottom = 1 << 4, outsideNear = 1 << 5,
+        frustumPlanes = (1 << 6) - 1,
+        beyondRightGuard = 1 << 6, beyondTopGuard = 1 << 7, beyondLeftGuard = 1 << 8, beyondBottomGuard = 1 << 9
+    };
+
+    // the sides of the frustum and of the guard band that the clipping space position pos is outside of
+    inline int outcode(const glm::vec4 &pos, float guardBand){
+        int code = 0;
+        if (pos.x > pos.w) code |= outsideRight;
+        if (pos.y > pos.w) code |= outsideTop;
+        if (pos.z > pos.w) code |= outsideFar;
+        if (-pos.x > pos.w) code |= outsideLeft;
+        if (-pos.y > pos.w) code |= outsideBottom;
+        if (-pos.z > pos.w) code |= outsideNear;
+        float guardW = pos.w * guardBand;
+        if (pos.x > guardW) code |= beyondRightGuard;
+        if (pos.y > guardW) code |= beyondTopGuard;
+        if (-pos.x > guardW) code |= beyondLeftGuard;
+        if (-pos.y > guardW) code |= beyondBottomGuard;
+        return code;
+    }
+
+#if defined(SRL_VERTEX_AVX) || defined(SRL_VERTEX_SSE)
+    namespace simd {
+        // the few operations of the vertex transform on SRL_VERTEX_BATCH floats, the comparisons return a mask with
+        // all bits set in the lanes where they are true
+#if defined(SRL_VERTEX_AVX)
+        typedef __m256 vfloat;
+        inline vfloat load(const float *p) { return _mm256_loadu_ps(p); }
+        inline void store(float *p, vfloat a) { _mm256_storeu_ps(p, a); }
+        inline vfloat set1(float x) { return _mm256_set1_ps(x); }
+        inline vfloat add(vfloat a, vfloat b) { return _mm256_add_ps(a, b); }
+        inline vfloat mul(vfloat a, vfloat b) { return _mm256_mul_ps(a, b); }
+        inline vfloat neg(vfloat a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.f)); }
+        inline vfloat greater(vfloat a, vfloat b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+        inline vfloat bitAnd(vfloat a, vfloat b) { return _mm256_and_ps(a, b); }
+        inline vfloat bitOr(vfloat a, vfloat b) { return _mm256_or_ps(a, b); }
+        inline vfloat bits(int b) { return _mm256_castsi256_ps(_mm256_set1_epi32(b)); }
+        inline void storeBits(int *p, vfloat a) { _mm256_storeu_si256((__m256i *) p, _mm256_castps_si256(a)); }
+#else
+        typedef __m128 vfloat;
+        inline vfloat load(const float *p) { return _mm_loadu_ps(p); }
+        inline void store(float *p, vfloat a) { _mm_storeu_ps(p, a); }
+        inline vfloat set1(float x) { return _mm_set1_ps(x); }
+        inline vfloat add(vfloat a, vfloat b) { return _mm_add_ps(a, b); }
+        inline vfloat mul(vfloat a, vfloat b) { return _mm_mul_ps(a, b); }
+        inline vfloat neg(vfloat a) { return _mm_xor_ps(a, _mm_set1_ps(-0.f)); }
+        inline vfloat greater(vfloat a, vfloat b) { return _mm_cmpgt_ps(a, b); }
+        inline vfloat bitAnd(vfloat a, vfloat b) { return _mm_and_ps(a, b); }
+        inline vfloat bitOr(vfloat a, vfloat b) { return _mm_or_ps(a, b); }
+        inline vfloat bits(int b) { return _mm_castsi128_ps(_mm_set1_epi32(b)); }
+        inline void storeBits(int *p, vfloat a) { _mm_storeu_si128((__m128i *) p, _mm_castps_si128(a)); }
+#endif
+
+        // row r of mvp times (x, y, z, w), in the same order of operations as glm's matrix times vector
+        inline vfloat row(const glm::mat4 &mvp, int r, vfloat x, vfloat y, vfloat z, vfloat w) {
+            return add(add(mul(set1(mvp[0][r]), x), mul(set1(mvp[1][r]), y)),
+                       add(mul(set1(mvp[2][r]), z), mul(set1(mvp[3][r]), w)));
+        }
+
+        // code |= bit in the lanes where a > b
+        inline vfloat addOutcode(vfloat code, vfloat a, vfloat b, int bit) {
+            return bitOr(code, bitAnd(greater(a, b), bits(bit)));
+        }
+    }
+#endif
+
+#if defined(SRL_VERTEX_AVX) || defined(SRL_VERTEX_SSE)
+    // true if pos is what the scalar code computes for the position in, up to rounding, and code is the outcode of pos.
+    // the batches of transformPositions must give that (checked in debug builds). the compiler can fuse or reorder the
+    // multiplications and additions of mvp * in differently in the two paths, so each coordinate can be off by a few
+    // ulps of the sum of the magnitudes of its 4 products
+    inline bool matchesScalar(const glm::mat4 &mvp, const glm::vec4 &in, float guardBand, const glm::vec4 &pos, int code) {
+        glm::vec4 scalar = mvp * in;
+        for (int r = 0; r < 4; r++) {
+            if (pos[r] == scalar[r] || (std::isnan(pos[r]) && std::isnan(scalar[r])))
+                continue;
+            float magnitude = std::abs(mvp[0][r] * in.x) + std::abs(mvp[1][r] * in.y) +
+                              std::abs(mvp[2][r] * in.z) + std::abs(mvp[3][r] * in.w);
+            if (!(std::abs(pos[r] - scalar[r]) <= 4 * FLT_EPSILON * magnitude))
+                return false;
+        }
+        return outcode(pos, guardBand) == code;
+    }
+#endif
+
+    // transforms the positions of the n vertices of in by mvp and computes their outcodes (see outcode) in the same
+    // pass, then calls output(i, pos, code) for each vertex i. the positions of a batch of SRL_VERTEX_BATCH vertices are
+    // transposed to one register per coordinate (x of all of them, y, ...), so each instruction works on the whole
+    // batch and the outcodes need no branches. the other attributes are left to output, which is called for the
+    // vertices in order
+    template <typename Output>
+    inline void transformPositions(const glm::mat4 &mvp, const vertex *in, size_t n, float guardBand, Output &&output) {
+        size_t first = 0;
+#if defined(SRL_VERTEX_AVX) || defined(SRL_VERTEX_SSE)
+        using namespace simd;
+        const int batch = SRL_VERTEX_BATCH;
+        for (; first + batch <= n; first += batch) {
+            float p[4][batch];
+            for (int i = 0; i < batch; i++)
+                for (int c = 0; c < 4; c++)
+                    p[c][i] = in[first + i].pos[c];
+            vfloat x = load(p[0]), y = load(p[1]), z = load(p[2]), w = load(p[3]);
+
+            vfloat cx = row(mvp, 0, x, y, z, w), cy = row(mvp, 1, x, y, z, w);
+            vfloat cz = row(mvp, 2, x, y, z, w), cw = row(mvp, 3, x, y, z, w);
+            store(p[0], cx);
+            store(p[1], cy);
+            store(p[2], cz);
+            store(p[3], cw);
+
+            vfloat code = bits(0), guardW = mul(cw, set1(guardBand));
+            code = addOutcode(code, cx, cw, outsideRight);
+            code = addOutcode(code, cy, cw, outsideTop);
+            code = addOutcode(code, cz, cw, outsideFar);
+            code = addOutcode(code, neg(cx), cw, outsideLeft);
+            code = addOutcode(code, neg(cy), cw, outsideBottom);
+            code = addOutcode(code, neg(cz), cw, outsideNear);
+            code = addOutcode(code, cx, guardW, beyondRightGuard);
+            code = addOutcode(code, cy, guardW, beyondTopGuard);
+            code = addOutcode(code, neg(cx), guardW, beyondLeftGuard);
+            code = addOutcode(code, neg(cy), guardW, beyondBottomGuard);
+            int codes[batch];
+            storeBits(codes, code);
+
+            for (int i = 0; i < batch; i++) {
+                glm::vec4 pos(p[0][i], p[1][i], p[2][i], p[3][i]);
+                assert(matchesScalar(mvp, in[first + i].pos, guardBand, pos, codes[i]));
+                output(first + i, pos, codes[i]);
+            }
+        }
+#endif
+        for (size_t i = first; i < n; i++) {
+            glm::vec4 pos = mvp * in[i].pos;
+            output(i, pos, outcode(pos, guardBand));
+        }
+    }
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_SRL_VERTEX_TRANSFORM_H
@@ -0,0 +1,114 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_SWR_COLOR_H
+#define ITU_GRAPHICS_PROGRAMMING_SWR_COLOR_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// the batched conversion uses SSE2 (always available on x86-64), plain scalar code on other platforms
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SWR_COLOR_SSE
+#endif
+
+// the conversions of the colors of the software renderers to RGBA8, srl::Colors of exercise 7 and rt::Colors of
+// exercise 10 (each adds the plain toRGBA32(color) of its types)
+namespace swr {
+
+    // how the colors (linear, clamped to [0, 1]) are quantized to the 8 bits channels of the frame buffer
+    struct Encoding {
+        // encode r, g and b with the sRGB transfer function, for displays that expect sRGB (alpha stays linear)
+        bool srgb = false;
+        // add a 4x4 ordered (Bayer) dither to r, g and b before quantizing, so smooth gradients don't show bands.
+        // without it the channels are truncated
+        bool dither = false;
+    };
+
+    // threshold of the ordered dither at pixel (x, y), in [0, 1) with an average of 1/2 over any 4x4 pixels
+    inline float ditherThreshold(unsigned int x, unsigned int y) {
+        static const unsigned char bayer[4][4] = {{0, 8, 2, 10}, {12, 4, 14, 6}, {3, 11, 1, 9}, {15, 7, 13, 5}};
+        return ((float) bayer[y & 3u][x & 3u] + .5f) / 16.f;
+    }
+
+    // sRGB transfer function of a channel in [0, 1]. the curve 1.055 x^(1/2.4) - 0.055 is approximated by a
+    // polynomial of x^(1/2), x^(1/4) and x^(1/8), which only needs square roots (also an SSE instruction).
+    // the error is below a quarter of an 8 bits step
+    inline float linearToSRGB(float x) {
+        float s1 = std::sqrt(x), s2 = std::sqrt(s1), s3 = std::sqrt(s2);
+        float curve = 0.662002687f * s1 + 0.684122060f * s2 - 0.323583601f * s3 - 0.0225411470f * x;
+        return x < 0.0031308f ? 12.92f * x : curve;
+    }
+
+    // inverse of the sRGB transfer function of a channel in [0, 1] (the exact curve, it is only used to decode
+    // 8 bits values, see MultisampleBuffer::resolve of exercise 7)
+    inline float sRGBToLinear(float x) {
+        return x <= 0.04045f ? x / 12.92f : std::pow((x + 0.055f) / 1.055f, 2.4f);
+    }
+
+    // toRGBA32 with the sRGB encoding of r, g and b if srgb, and threshold (in [0, 1)) added to them before the
+    // truncation to 8 bits
+    inline std::uint32_t toRGBA32(glm::vec4 c, bool srgb, float threshold) {
+        glm::vec4 c_clamp = glm::clamp(c, 0.f, 1.f);
+        std::uint32_t out = std::uint32_t(255 * c_clamp.a) << 24;
+        for (int i = 0; i < 3; i++)
+            out |= std::uint32_t(255 * (srgb ? linearToSRGB(c_clamp[i]) : c_clamp[i]) + threshold) << (8 * i);
+        return out;
+    }
+
+    // toRGBA32 of the pixel (x, y) with an encoding
+    inline std::uint32_t toRGBA32(glm::vec4 c, Encoding encoding, unsigned int x, unsigned int y) {
+        return toRGBA32(c, encoding.srgb, encoding.dither ? ditherThreshold(x, y) : 0.f);
+    }
+
+#if defined(SWR_COLOR_SSE)
+    // linearToSRGB of the 4 lanes of x
+    inline __m128 linearToSRGB(__m128 x) {
+        __m128 s1 = _mm_sqrt_ps(x), s2 = _mm_sqrt_ps(s1), s3 = _mm_sqrt_ps(s2);
+        __m128 curve = _mm_sub_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.662002687f), s1),
+                                                        _mm_mul_ps(_mm_set1_ps(0.684122060f), s2)),
+                                             _mm_mul_ps(_mm_set1_ps(0.323583601f), s3)),
+                                  _mm_mul_ps(_mm_set1_ps(0.0225411470f), x));
+        __m128 linear = _mm_cmplt_ps(x, _mm_set1_ps(0.0031308f));
+        return _mm_or_ps(_mm_and_ps(linear, _mm_mul_ps(_mm_set1_ps(12.92f), x)), _mm_andnot_ps(linear, curve));
+    }
+#endif
+
+    // converts n colors at once, out[i] is toRGBA32 of in[i] with the dither threshold threshold(i) (0 for none).
+    // with SSE2 the 4 channels of a color are the 4 lanes of a register, so each color takes a few instructions
+    // without any shuffling, and the channels of 4 colors are packed to bytes together
+    template <typename Threshold>
+    inline void toRGBA32(const glm::vec4 *in, std::uint32_t *out, size_t n, bool srgb, Threshold &&threshold) {
+        size_t i = 0;
+#if defined(SWR_COLOR_SSE)
+        const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f), scale = _mm_set1_ps(255.f);
+        // the lanes of r, g and b, alpha is neither encoded nor dithered
+        const __m128 rgb = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+        auto convert = [&](size_t j) {
+            __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&in[j][0]), zero), one);
+            if (srgb)
+                v = _mm_or_ps(_mm_and_ps(rgb, linearToSRGB(v)), _mm_andnot_ps(rgb, v));
+            __m128 t = _mm_and_ps(rgb, _mm_set1_ps(threshold(j)));
+            return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), t));
+        };
+        for (; i + 4 <= n; i += 4) {
+            // 32 bits to 16 to 8, the values are in [0, 255] so the saturation of the packs doesn't change them
+            __m128i lo = _mm_packs_epi32(convert(i), convert(i + 1));
+            __m128i hi = _mm_packs_epi32(convert(i + 2), convert(i + 3));
+            _mm_storeu_si128((__m128i *) (out + i), _mm_packus_epi16(lo, hi));
+        }
+#endif
+        for (; i < n; i++)
+            out[i] = toRGBA32(in[i], srgb, threshold(i));
+    }
+
+    // converts the n colors of a row of pixels that starts at pixel (x, y)
+    inline void toRGBA32(const glm::vec4 *in, std::uint32_t *out, size_t n, Encoding encoding, unsigned int x, unsigned int y) {
+        if (encoding.dither)
+            toRGBA32(in, out, n, encoding.srgb, [&](size_t i) { return ditherThreshold(x + (unsigned int) i, y); });
+        else
+            toRGBA32(in, out, n, encoding.srgb, [](size_t) { return 0.f; });
+    }
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_SWR_COLOR_H
@@ -0,0 +1,280 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_SWR_FRAME_BUFFER_H
+#define ITU_GRAPHICS_PROGRAMMING_SWR_FRAME_BUFFER_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+// the frame buffer of the software renderers, the rasterizer of exercise 7 (srl::CustomFrameBuffer) and the ray
+// tracer of exercise 10 (FrameBuffer)
+namespace swr {
+
+    // memory layouts of the pixels of a FrameBuffer, they map the pixel (x, y) to its index in the buffer.
+    // block_size is the width and height of the squares of pixels that are close in memory, 0 if it is row by row
+
+    // row by row, buffer[x + y * W], the layout OpenGL expects (e.g. in glTexImage2D)
+    class LinearLayout {
+    public:
+        static const unsigned int block_size = 0;
+
+        LinearLayout(unsigned int width, unsigned int height) : W(width), H(height) {}
+        size_t size() const { return size_t(W) * H; }
+        size_t index(unsigned int x, unsigned int y) const { return x + size_t(y) * W; }
+
+    private:
+        unsigned int W, H;
+    };
+
+    // tiles of 8x8 pixels row by row, the pixels of a tile are row by row too. the 64 pixels of a tile are
+    // contiguous, so a thread working on a tile (or a block of the block rasterizer) touches 4 cache lines of 32 bits
+    // pixels instead of 8 rows. the tiles at the right and top edges are padded
+    class TiledLayout {
+    public:
+        static const unsigned int block_size = 8;
+
+        TiledLayout(unsigned int width, unsigned int height)
+                : tilesX((width + block_size - 1) / block_size), tilesY((height + block_size - 1) / block_size) {}
+        size_t size() const { return size_t(tilesX) * tilesY * block_size * block_size; }
+        size_t index(unsigned int x, unsigned int y) const {
+            return (size_t(y / block_size) * tilesX + x / block_size) * block_size * block_size +
+                   (y % block_size) * block_size + x % block_size;
+        }
+
+    private:
+        unsigned int tilesX, tilesY;
+    };
+
+    // Morton (Z) order: the bits of x and y are interleaved, so every aligned square of 2^n x 2^n pixels is
+    // contiguous, whatever its size. the width and height are padded to powers of two, and if they differ the extra
+    // bits of the biggest one are above the interleaved bits (a row or column of Morton ordered squares)
+    class MortonLayout {
+    public:
+        static const unsigned int block_size = 8;
+
+        MortonLayout(unsigned int width, unsigned int height) : bitsX(bitsFor(width)), bitsY(bitsFor(height)) {}
+        size_t size() const { return size_t(1) << (bitsX + bitsY); }
+        size_t index(unsigned int x, unsigned int y) const {
+            unsigned int common = bitsX < bitsY ? bitsX : bitsY;
+            unsigned int mask = (1u << common) - 1;
+            size_t low = spreadBits(x & mask) | (spreadBits(y & mask) << 1);
+            size_t high = bitsX > bitsY ? (x >> common) : (y >> common);
+            return low | (high << (2 * common));
+        }
+
+    private:
+        // number of bits of the coordinates up to size - 1
+        static unsigned int bitsFor(unsigned int size) {
+            unsigned int bits = 0;
+            while ((1u << bits) < size)
+                bits++;
+            return bits;
+        }
+
+        // inserts a zero bit after each of the 16 lower bits of v
+        static size_t spreadBits(unsigned int v) {
+            size_t r = v & 0xffffu;
+            r = (r | (r << 8)) & 0x00ff00ffu;
+            r = (r | (r << 4)) & 0x0f0f0f0fu;
+            r = (r | (r << 2)) & 0x33333333u;
+            r = (r | (r << 1)) & 0x55555555u;
+            return r;
+        }
+
+        unsigned int bitsX, bitsY;
+    };
+
+    // the pixels are in buffer in the order of Layout, which is row by row only with LinearLayout (the default).
+    // with the other layouts, linearize copies them row by row, e.g. to upload them with glTexImage2D.
+    // the buffer is split in tiles of tile_size x tile_size pixels that track two things:
+    // - fast clears: clearBuffer only marks the tiles as cleared, and a tile is filled with the clear value when a
+    //   pixel of it is first painted (valueAt returns the clear value until then). code that reads or writes buffer
+    //   directly calls resolveClears or prepareWrite first
+    // - dirty tiles: the tiles that changed since the last visitDirtyRects, so that only they are presented
+    template<class T, class Layout = LinearLayout>
+    class FrameBuffer {
+    public:
+        // same as the blocks of the block rasterizer and the hierarchical z buffer of exercise 7, and the tiles of its
+        // binning renderer are made of whole blocks, so a tile is never painted by two threads
+        static const unsigned int tile_size = 8;
+
+        unsigned int W, H;
+        T *buffer;
+
+        FrameBuffer(unsigned int width, unsigned int height): W(width), H(height), layout(width, height),
+                tilesX((width + tile_size - 1) / tile_size), tilesY((height + tile_size - 1) / tile_size) {
+            buffer = new T[layout.size()];
+            // nothing was presented yet, so all tiles are dirty
+            cleared.assign(tilesX * tilesY, 0);
+            painted.assign(tilesX * tilesY, 1);
+            dirty.assign(tilesX * tilesY, 1);
+        }
+
+        ~FrameBuffer(){delete[] buffer;} // clean our memory
+
+        // clears all pixels to value in O(tiles), the pixels are only written when their tile is painted
+        void clearBuffer(T value){
+            bool sameValue = hasClearValue && clearValue == value;
+            for (size_t t = 0; t < cleared.size(); t++) {
+                // a tile that was not painted since it was cleared to the same value doesn't change
+                if (painted[t] || !sameValue)
+                    dirty[t] = 1;
+                cleared[t] = 1;
+                painted[t] = 0;
+            }
+            clearValue = value;
+            hasClearValue = true;
+        }
+
+        // clears all pixels to value now, for code that only accesses buffer directly
+        void fillBuffer(T value){
+            size_t size = layout.size();
+            for (size_t i = 0; i < size; i++)
+                buffer[i] = value;
+            std::fill(cleared.begin(), cleared.end(), 0);
+            std::fill(painted.begin(), painted.end(), 1);
+            std::fill(dirty.begin(), dirty.end(), 1);
+        }
+
+        void paintAt(unsigned int x, unsigned int y, T value){
+            assert(x < W && y < H); // ensure valid position, crash if not (sooo dramatic!)
+            size_t t = tileOf(x, y);
+            if (cleared[t])
+                fillTile(t);
+            painted[t] = 1;
+            dirty[t] = 1;
+            buffer[layout.index(x, y)] = value;
+        }
+
+        T valueAt(unsigned int x, unsigned int y){
+            assert(x < W && y < H);
+            return cleared[tileOf(x, y)] ? clearValue : buffer[layout.index(x, y)];
+        }
+
+        // index of the pixel (x, y) in buffer
+        size_t indexOf(unsigned int x, unsigned int y) const { return layout.index(x, y); }
+
+        // true if the pixel (x, y) is still cleared to clearValue, without its value in buffer
+        bool isCleared(unsigned int x, unsigned int y) const { return cleared[tileOf(x, y)] != 0; }
+        T lastClearValue() const { return clearValue; }
+
+        // the pixels of the rectangle [x0, x1] x [y0, y1] are going to be written directly in buffer: the cleared
+        // tiles it overlaps are filled, or not if overwrite is true and the rectangle covers them completely, and
+        // they are marked dirty
+        void prepareWrite(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, bool overwrite = false){
+            for (unsigned int ty = y0 / tile_size; ty <= y1 / tile_size; ty++) {
+                for (unsigned int tx = x0 / tile_size; tx <= x1 / tile_size; tx++) {
+                    size_t t = ty * tilesX + tx;
+                    bool covered = tx * tile_size >= x0 && std::min(W, (tx + 1) * tile_size) - 1 <= x1 &&
+                                   ty * tile_size >= y0 && std::min(H, (ty + 1) * tile_size) - 1 <= y1;
+                    if (cleared[t] && !(overwrite && covered))
+                        fillTile(t);
+                    cleared[t] = 0;
+                    painted[t] = 1;
+                    dirty[t] = 1;
+                }
+            }
+        }
+
+        // fills all the tiles that are still cleared, so that buffer can be read directly
+        void resolveClears(){
+            for (size_t t = 0; t < cleared.size(); t++)
+                if (cleared[t])
+                    fillTile(t);
+        }
+
+        // calls visit(x, y, width, height) for rectangles that cover the tiles that changed since the last call (and
+        // sometimes a few that didn't), with their pixels resolved in buffer, and marks all tiles clean.
+        // each tile row gives the span from its first to its last dirty tile, and consecutive rows with the same
+        // span are merged. with LinearLayout the rectangle starts at buffer + x + y * W, with rows of W pixels, e.g.
+        // for glTexSubImage2D with GL_UNPACK_ROW_LENGTH == W
+        template <class Visitor>
+        void visitDirtyRects(Visitor &&visit){
+            unsigned int spanY = 0, spanRows = 0, spanX0 = 0, spanX1 = 0;
+            auto flush = [&]() {
+                if (spanRows == 0)
+                    return;
+                for (unsigned int ty = spanY; ty < spanY + spanRows; ty++)
+                    for (unsigned int tx = spanX0; tx <= spanX1; tx++)
+                        if (cleared[ty * tilesX + tx])
+                            fillTile(ty * tilesX + tx);
+                unsigned int x = spanX0 * tile_size, y = spanY * tile_size;
+                visit(x, y, std::min(W, (spanX1 + 1) * tile_size) - x, std::min(H, (spanY + spanRows) * tile_size) - y);
+                spanRows = 0;
+            };
+
+            for (unsigned int ty = 0; ty < tilesY; ty++) {
+                unsigned int x0 = tilesX, x1 = 0;
+                for (unsigned int tx = 0; tx < tilesX; tx++) {
+                    if (dirty[ty * tilesX + tx]) {
+                        x0 = std::min(x0, tx);
+                        x1 = tx;
+                        dirty[ty * tilesX + tx] = 0;
+                    }
+                }
+                if (x0 > x1) {
+                    flush();
+                    continue;
+                }
+                if (spanRows > 0 && (spanX0 != x0 || spanX1 != x1))
+                    flush();
+                if (spanRows == 0) {
+                    spanY = ty;
+                    spanX0 = x0;
+                    spanX1 = x1;
+                }
+                spanRows++;
+            }
+            flush();
+        }
+
+        // calls visit(x, y, pixel) for the pixels in the rectangle [x0, x1] x [y0, y1], block by block in the order of
+        // the layout, so that consecutive calls touch consecutive memory (call prepareWrite before writing them)
+        template <class Visitor>
+        void visitRect(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, Visitor &&visit){
+            const unsigned int b = Layout::block_size;
+            if (b == 0) {
+                for (unsigned int y = y0; y <= y1; y++)
+                    for (unsigned int x = x0; x <= x1; x++)
+                        visit(x, y, buffer[layout.index(x, y)]);
+                return;
+            }
+            for (unsigned int by = y0; by <= y1; by = (by / b + 1) * b) {
+                unsigned int ey = std::min(y1, (by / b + 1) * b - 1);
+                for (unsigned int bx = x0; bx <= x1; bx = (bx / b + 1) * b) {
+                    unsigned int ex = std::min(x1, (bx / b + 1) * b - 1);
+                    for (unsigned int y = by; y <= ey; y++)
+                        for (unsigned int x = bx; x <= ex; x++)
+                            visit(x, y, buffer[layout.index(x, y)]);
+                }
+            }
+        }
+
+        // copies the pixels row by row to out (W * H values), what presenting the frame needs with non linear layouts
+        void linearize(T *out) const {
+            for (unsigned int y = 0; y < H; y++)
+                for (unsigned int x = 0; x < W; x++)
+                    out[x + y * W] = isCleared(x, y) ? clearValue : buffer[layout.index(x, y)];
+        }
+
+    private:
+        size_t tileOf(unsigned int x, unsigned int y) const { return (y / tile_size) * tilesX + x / tile_size; }
+
+        void fillTile(size_t t){
+            unsigned int x0 = (unsigned int) (t % tilesX) * tile_size, y0 = (unsigned int) (t / tilesX) * tile_size;
+            visitRect(x0, y0, std::min(W, x0 + tile_size) - 1, std::min(H, y0 + tile_size) - 1,
+                      [&](unsigned int, unsigned int, T &pixel){ pixel = clearValue; });
+            cleared[t] = 0;
+        }
+
+        Layout layout;
+        unsigned int tilesX, tilesY;
+        // per tile flags, bytes so that threads working on different tiles never write the same memory location.
+        // cleared: the pixels are not filled with the clear value yet, painted: written since the last clear
+        std::vector<unsigned char> cleared, painted, dirty;
+        T clearValue = T();
+        bool hasClearValue = false;
+    };
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_SWR_FRAME_BUFFER_H
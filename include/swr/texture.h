@@ -0,0 +1,175 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_SWR_TEXTURE_H
+#define ITU_GRAPHICS_PROGRAMMING_SWR_TEXTURE_H
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+// the texture of the software renderers, srl::Texture of exercise 7 and rt::Texture of exercise 10
+namespace swr {
+
+    // RGBA8 texture (packed as Colors::toRGBA32) with a chain of mip levels, sampled with repeat wrapping.
+    // the texels of each level are stored in tiles of tile_size x tile_size texels (64 bytes, the size of a cache line,
+    // but the storage isn't aligned so a tile can span two lines), so the 4 texels of a bilinear fetch and the fetches
+    // of the neighbouring pixels are in the same few lines whatever the orientation of the triangle in the texture
+    // (in rows, a vertical walk touches a line per texel)
+    class Texture {
+    public:
+        enum Filter {
+            // the closest texel of the closest mip level
+            nearest,
+            // bilinear interpolation of the 4 closest texels of the closest mip level
+            bilinear,
+            // bilinear interpolation in the two closest mip levels, and linear interpolation between them
+            trilinear
+        };
+
+        static const int tile_size = 4;
+
+        Texture() = default;
+
+        // texture of width x height texels, rgba is row by row as in FrameBuffer<uint32_t> with LinearLayout
+        Texture(unsigned int width, unsigned int height, const std::uint32_t *rgba) {
+            load(width, height, rgba);
+        }
+
+        // replaces the texels, and builds the mip levels by averaging blocks of 2x2 texels down to 1x1.
+        // a width or height of 0 leaves the texture empty
+        void load(unsigned int width, unsigned int height, const std::uint32_t *rgba) {
+            m_levels.clear();
+            if (width == 0 || height == 0)
+                return;
+            std::vector<std::uint32_t> linear(rgba, rgba + width * height);
+            int w = (int) width, h = (int) height;
+            while (true) {
+                m_levels.emplace_back(w, h, linear);
+                if (w == 1 && h == 1)
+                    break;
+
+                // odd sizes: the last row or column is averaged with itself
+                int w2 = std::max(1, w / 2), h2 = std::max(1, h / 2);
+                std::vector<std::uint32_t> next(w2 * h2);
+                for (int y = 0; y < h2; y++) {
+                    for (int x = 0; x < w2; x++) {
+                        int x0 = std::min(2 * x, w - 1), x1 = std::min(2 * x + 1, w - 1);
+                        int y0 = std::min(2 * y, h - 1), y1 = std::min(2 * y + 1, h - 1);
+                        const std::uint32_t quad[4] = {linear[y0 * w + x0], linear[y0 * w + x1],
+                                                       linear[y1 * w + x0], linear[y1 * w + x1]};
+                        std::uint32_t out = 0;
+                        for (int shift = 0; shift < 32; shift += 8) {
+                            std::uint32_t sum = 2;
+                            for (std::uint32_t t : quad)
+                                sum += (t >> shift) & 0xffu;
+                            out |= (sum / 4) << shift;
+                        }
+                        next[y * w2 + x] = out;
+                    }
+                }
+                linear.swap(next);
+                w = w2;
+                h = h2;
+            }
+        }
+
+        bool empty() const { return m_levels.empty(); }
+        int width() const { return m_levels.empty() ? 0 : m_levels[0].W; }
+        int height() const { return m_levels.empty() ? 0 : m_levels[0].H; }
+        int levels() const { return (int) m_levels.size(); }
+
+        // level of detail of a pixel whose texture coordinates change by dUVdx and dUVdy from one pixel to the next
+        // (or across the footprint of a ray), the log2 of the number of texels of level 0 it covers along its longest axis
+        float lod(const glm::vec2 &dUVdx, const glm::vec2 &dUVdy) const {
+            glm::vec2 size(width(), height());
+            glm::vec2 dx = dUVdx * size, dy = dUVdy * size;
+            float rho2 = std::max(glm::dot(dx, dx), glm::dot(dy, dy));
+            // log2(sqrt(rho2)), the small minimum avoids the log of zero
+            return .5f * std::log2(std::max(rho2, 1e-20f));
+        }
+
+        // color of the texture at the texture coordinates uv (texel centers at (i + .5) / size) and level of detail lod.
+        // a negative lod is a magnification, which samples level 0
+        glm::vec4 sample(const glm::vec2 &uv, float lod, Filter filter) const {
+            if (m_levels.empty())
+                return glm::vec4(1);
+
+            float maxLevel = (float) (m_levels.size() - 1);
+            lod = std::min(std::max(lod, 0.f), maxLevel);
+            if (filter != trilinear) {
+                const Level &level = m_levels[(int) (lod + .5f)];
+                return filter == nearest ? sampleNearest(level, uv) : sampleBilinear(level, uv);
+            }
+
+            int l0 = (int) lod;
+            float t = lod - (float) l0;
+            glm::vec4 c0 = sampleBilinear(m_levels[l0], uv);
+            if (t == 0.f)
+                return c0;
+            return glm::mix(c0, sampleBilinear(m_levels[l0 + 1], uv), t);
+        }
+
+        // single texel (x, y) of a mip level, with repeat wrapping
+        glm::vec4 texel(int level, int x, int y) const {
+            const Level &l = m_levels[level];
+            return toColor(l.at(wrap(x, l.W), wrap(y, l.H)));
+        }
+
+    private:
+        struct Level {
+            int W, H;
+            int tilesX;
+            std::vector<std::uint32_t> texels;
+
+            // swizzles the texels of a level from rows to tiles, the tiles at the right and top edges are padded
+            Level(int width, int height, const std::vector<std::uint32_t> &linear)
+                    : W(width), H(height), tilesX((width + tile_size - 1) / tile_size) {
+                int tilesY = (height + tile_size - 1) / tile_size;
+                texels.assign(tilesX * tilesY * tile_size * tile_size, 0);
+                for (int y = 0; y < H; y++)
+                    for (int x = 0; x < W; x++)
+                        texels[index(x, y)] = linear[y * W + x];
+            }
+
+            int index(int x, int y) const {
+                int tile = (y / tile_size) * tilesX + x / tile_size;
+                return tile * tile_size * tile_size + (y % tile_size) * tile_size + x % tile_size;
+            }
+
+            // texel at (x, y), which must be inside of the level
+            std::uint32_t at(int x, int y) const { return texels[index(x, y)]; }
+        };
+
+        static int wrap(int x, int size) {
+            x %= size;
+            return x < 0 ? x + size : x;
+        }
+
+        static glm::vec4 toColor(std::uint32_t t) {
+            return glm::vec4(t & 0xffu, (t >> 8) & 0xffu, (t >> 16) & 0xffu, t >> 24) * (1.f / 255.f);
+        }
+
+        static glm::vec4 sampleNearest(const Level &level, const glm::vec2 &uv) {
+            int x = (int) std::floor(uv.x * (float) level.W);
+            int y = (int) std::floor(uv.y * (float) level.H);
+            return toColor(level.at(wrap(x, level.W), wrap(y, level.H)));
+        }
+
+        static glm::vec4 sampleBilinear(const Level &level, const glm::vec2 &uv) {
+            // position relative to the texel centers
+            float fx = uv.x * (float) level.W - .5f, fy = uv.y * (float) level.H - .5f;
+            float x0f = std::floor(fx), y0f = std::floor(fy);
+            float tx = fx - x0f, ty = fy - y0f;
+            int x0 = wrap((int) x0f, level.W), y0 = wrap((int) y0f, level.H);
+            int x1 = x0 + 1 == level.W ? 0 : x0 + 1, y1 = y0 + 1 == level.H ? 0 : y0 + 1;
+
+            glm::vec4 bottom = glm::mix(toColor(level.at(x0, y0)), toColor(level.at(x1, y0)), tx);
+            glm::vec4 top = glm::mix(toColor(level.at(x0, y1)), toColor(level.at(x1, y1)), tx);
+            return glm::mix(bottom, top, ty);
+        }
+
+        std::vector<Level> m_levels;
+    };
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_SWR_TEXTURE_H